@@ -0,0 +1,50 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosio.system/fixed_point.hpp>
+
+#include <cmath>
+#include <cstdint>
+
+namespace eosiosystem {
+
+   /**
+    *  Bancor conversions of exchange_state, on plain amounts so that they can be evaluated with either
+    *  double or fixed_point as `Real` and compared natively.
+    */
+
+   /// relay tokens issued for `in` deposited to a connector that holds `balance` with `weight`
+   template<typename Real>
+   int64_t bancor_to_exchange( int64_t supply, int64_t balance, int64_t in, double weight ) {
+      using std::pow;
+
+      Real R(supply);
+      Real C(balance+in);
+      Real F(weight);
+      Real T(in);
+      Real ONE(1.0);
+
+      Real E = -R * (ONE - pow( ONE + T / C, F) );
+      return int64_t(E);
+   }
+
+   /// connector tokens paid out for `in` relay tokens, taken from a connector that holds `balance` with `weight`
+   template<typename Real>
+   int64_t bancor_from_exchange( int64_t supply, int64_t balance, int64_t in, double weight ) {
+      using std::pow;
+
+      Real R(supply - in);
+      Real C(balance);
+      Real F(1.0/weight);
+      Real E(in);
+      Real ONE(1.0);
+
+      // potentially more accurate for small E/R: Real T = C * expm1( F * log1p(E/R) );
+      Real T = C * (pow( ONE + E/R, F) - ONE);
+      return int64_t(T);
+   }
+
+} /// namespace eosiosystem
@@ -9,8 +9,11 @@
 #include <eosiolib/time.hpp>
 #include <eosiolib/privileged.hpp>
 #include <eosiolib/singleton.hpp>
+#include <eosiolib/binary_extension.hpp>
 #include <eosio.system/exchange_state.hpp>
 
+#include <boost/container/flat_map.hpp>
+
 #include <string>
 #include <type_traits>
 #include <optional>
@@ -27,6 +30,7 @@ namespace eosiosystem {
    using eosio::time_point;
    using eosio::microseconds;
    using eosio::datastream;
+   using eosio::binary_extension;
 
    template<typename E, typename F>
    static inline auto has_field( F flags, E field )
@@ -116,8 +120,35 @@ namespace eosiosystem {
       eosio_global_state3() { }
       time_point        last_vpay_state_update;
       double            total_vpay_share_change_rate = 0;
+      binary_extension<capi_checksum256> last_proposed_schedule_hash; ///< sha256 of the last schedule passed to set_proposed_producers
+      binary_extension<uint32_t>         refund_delay_sec;            ///< delay of unstaked tokens, absent or 0 returns them inline
+
+      EOSLIB_SERIALIZE( eosio_global_state3, (last_vpay_state_update)(total_vpay_share_change_rate)(last_proposed_schedule_hash)(refund_delay_sec) )
+   };
+
+   /**
+    * Blocks `producer` produced since the last schedule update or claim, counted here by onblock so that a
+    * block updates this one small row instead of the producer_info row and the global state. The counts are
+    * folded into producer_info::unpaid_blocks and eosio_global_state::total_unpaid_blocks by fold_unpaid_blocks.
+    */
+   struct [[eosio::table("unpaidblocks"), eosio::contract("eosio.system")]] producer_block_count {
+      name              producer;
+      uint32_t          blocks = 0;
 
-      EOSLIB_SERIALIZE( eosio_global_state3, (last_vpay_state_update)(total_vpay_share_change_rate) )
+      uint64_t primary_key()const { return producer.value; }
+
+      EOSLIB_SERIALIZE( producer_block_count, (producer)(blocks) )
+   };
+
+   /**
+    * Vote weight multiplier of the current week, see stake2vote. It only changes once a week, so it is
+    * computed by the first vote weight update of the week and read from here by the following ones.
+    */
+   struct [[eosio::table("votedecay"), eosio::contract("eosio.system")]] vote_decay_state {
+      uint32_t          week = 0;        ///< weeks since the block timestamp epoch
+      double            multiplier = 1;  ///< 2^(week/52)
+
+      EOSLIB_SERIALIZE( vote_decay_state, (week)(multiplier) )
    };
 
    struct [[eosio::table, eosio::contract("eosio.system")]] producer_info {
@@ -176,8 +207,20 @@ namespace eosiosystem {
       uint32_t            reserved2 = 0;
       eosio::asset        reserved3;
 
+      /**
+       * Compact form of `producers`, written by update_votes instead of the names only in builds with
+       * EOSIO_SYSTEM_PRODUCER_BITS: bit i of word w is set when the producer in slot 64*w + i is voted for.
+       * Voters written before keep their names in `producers` until their next vote. Off-chain readers of
+       * `producers` have to decode the bits through the prodslots table on chains that opt in.
+       */
+      binary_extension<std::vector<uint64_t>> producer_bits;
+
       uint64_t primary_key()const { return owner.value; }
 
+      bool has_producer_votes()const {
+         return !producers.empty() || ( producer_bits.has_value() && !producer_bits.value().empty() );
+      }
+
       enum class flags1_fields : uint32_t {
          ram_managed = 1,
          net_managed = 2,
@@ -185,11 +228,33 @@ namespace eosiosystem {
       };
 
       // explicit serialization macro is not necessary, used here only to improve compilation time
-      EOSLIB_SERIALIZE( voter_info, (owner)(proxy)(producers)(staked)(last_vote_weight)(proxied_vote_weight)(is_proxy)(flags1)(reserved2)(reserved3) )
+      EOSLIB_SERIALIZE( voter_info, (owner)(proxy)(producers)(staked)(last_vote_weight)(proxied_vote_weight)(is_proxy)(flags1)(reserved2)(reserved3)
+                        (producer_bits) )
    };
 
    typedef eosio::multi_index< "voters"_n, voter_info >  voters_table;
 
+   /**
+    * Registry of the bit positions used by voter_info::producer_bits. A slot is assigned to a producer
+    * the first time it is voted for and counts the voter bitsets it is set in; when the last one drops
+    * it, the owner is cleared and the slot goes to the next producer voted for, so bitsets stay as
+    * long as the number of producers currently voted for.
+    */
+   struct [[eosio::table, eosio::contract("eosio.system")]] producer_slot {
+      uint64_t          slot;
+      name              owner;   ///< empty while the slot is free
+      uint64_t          voters = 0;
+
+      uint64_t primary_key()const { return slot;        }
+      uint64_t by_owner()const    { return owner.value; }
+
+      EOSLIB_SERIALIZE( producer_slot, (slot)(owner)(voters) )
+   };
+
+   typedef eosio::multi_index< "prodslots"_n, producer_slot,
+                               indexed_by<"byowner"_n, const_mem_fun<producer_slot, uint64_t, &producer_slot::by_owner> >
+                             > producer_slots_table;
+
 
    typedef eosio::multi_index< "producers"_n, producer_info,
                                indexed_by<"prototalvote"_n, const_mem_fun<producer_info, double, &producer_info::by_votes>  >
@@ -199,6 +264,35 @@ namespace eosiosystem {
    typedef eosio::singleton< "global"_n, eosio_global_state >   global_state_singleton;
    typedef eosio::singleton< "global2"_n, eosio_global_state2 > global_state2_singleton;
    typedef eosio::singleton< "global3"_n, eosio_global_state3 > global_state3_singleton;
+   typedef eosio::multi_index< "unpaidblocks"_n, producer_block_count > unpaid_blocks_table;
+   typedef eosio::singleton< "votedecay"_n, vote_decay_state > vote_decay_singleton;
+
+   /**
+    *  Resource limits of one account for setacctres. Each field has the meaning of the argument of
+    *  setacctram, setacctnet or setacctcpu: a value makes the resource managed, none unmanages it.
+    */
+   struct account_resources {
+      name                    account;
+      std::optional<int64_t>  ram_bytes;
+      std::optional<int64_t>  net_weight;
+      std::optional<int64_t>  cpu_weight;
+
+      EOSLIB_SERIALIZE( account_resources, (account)(ram_bytes)(net_weight)(cpu_weight) )
+   };
+
+   /**
+    *  Account created by newaccounts, with the resource limits it starts with.
+    */
+   struct sidechain_account {
+      name                    account;
+      authority               owner;
+      authority               active;
+      std::optional<int64_t>  ram_bytes;        ///< RAM limit, none to follow the RAM token balance of the account
+      int64_t                 net_weight = -1;
+      int64_t                 cpu_weight = -1;
+
+      EOSLIB_SERIALIZE( sidechain_account, (account)(owner)(active)(ram_bytes)(net_weight)(cpu_weight) )
+   };
 
    //   static constexpr uint32_t     max_inflation_rate = 5;  // 5% annual inflation
    static constexpr uint32_t     seconds_per_day = 24 * 3600;
@@ -208,12 +302,17 @@ namespace eosiosystem {
          voters_table            _voters;
          producers_table         _producers;
          producers_table2        _producers2;
+         producer_slots_table    _producer_slots;
          global_state_singleton  _global;
          global_state2_singleton _global2;
          global_state3_singleton _global3;
-         eosio_global_state      _gstate;
-         eosio_global_state2     _gstate2;
-         eosio_global_state3     _gstate3;
+         std::optional<eosio_global_state>  _gstate;    // loaded on first use, see gstate()
+         std::optional<eosio_global_state2> _gstate2;
+         std::optional<eosio_global_state3> _gstate3;
+         std::vector<char>       _gstate_packed;   // global states as loaded, see save_if_changed
+         std::vector<char>       _gstate2_packed;
+         std::vector<char>       _gstate3_packed;
+         std::optional<vote_decay_state>    _vote_decay; // loaded on first use, see stake2vote()
          rammarket               _rammarket;
 
       public:
@@ -256,6 +355,28 @@ namespace eosiosystem {
          [[eosio::action]]
          void setacctcpu( name account, std::optional<int64_t> cpu_weight );
 
+         /**
+          *  Sets the RAM, NET and CPU limits of many accounts, with one voters row update and one
+          *  set_resource_limits per account.
+          */
+         [[eosio::action]]
+         void setacctres( const std::vector<account_resources>& accounts );
+
+         /**
+          *  Creates many sidechain accounts in one action: an inline newaccount for each of them,
+          *  followed by a single setacctres that sets the limits of all of them.
+          */
+         [[eosio::action]]
+         void newaccounts( name creator, const std::vector<sidechain_account>& accounts );
+
+         /**
+          *  Copies the ram_managed flag of each of 'accounts' to the mirror in eosio.token. Needed once
+          *  for accounts that were unmanaged before the mirror existed, later changes are mirrored by
+          *  setacctram and setacctres.
+          */
+         [[eosio::action]]
+         void mirrorram( const std::vector<name>& accounts );
+
          // functions defined in delegate_bandwidth.cpp
 
          /**
@@ -306,6 +427,13 @@ namespace eosiosystem {
          [[eosio::action]]
          void sellram( name account, int64_t bytes );
 
+         /**
+          *  Prints the RAM bytes that buyram would reserve for `quant` core tokens, or the core tokens
+          *  that sellram would return for `quant` RAM bytes, without modifying the market.
+          */
+         [[eosio::action]]
+         void quoteram( asset quant );
+
          /**
           *  This action is called after the delegation-period to claim all pending
           *  unstaked tokens belonging to owner
@@ -326,6 +454,13 @@ namespace eosiosystem {
          [[eosio::action]]
          void setramrate( uint16_t bytes_per_block );
 
+         /**
+          *  Sets how long unstaked tokens are held in the refunds table before the deferred refund
+          *  returns them. With 0 undelegatebw transfers them back right away.
+          */
+         [[eosio::action]]
+         void setrefdelay( uint32_t delay_sec );
+
          [[eosio::action]]
          void voteproducer( const name voter, const name proxy, const std::vector<name>& producers );
 
@@ -370,18 +505,51 @@ namespace eosiosystem {
 
          symbol core_symbol()const;
 
+         eosio_global_state&  gstate();
+         eosio_global_state2& gstate2();
+         eosio_global_state3& gstate3();
+
+         template<typename Singleton, typename State>
+         void save_if_changed( Singleton& singleton, const State& state, const std::vector<char>& packed ) {
+            if( eosio::pack( state ) != packed )
+               singleton.set( state, _self );
+         }
+
          void update_ram_supply();
 
          //defined in delegate_bandwidth.cpp
+         uint32_t refund_delay_sec();
+         /**
+          * Moves stake between "from" and "receiver". The delband, userres and refunds rows and the voters
+          * rows are each read once; delband and userres are written once with the totals computed in memory.
+          * The voters row of "from" is written a second time by update_votes when it votes or has a proxy.
+          */
          void changebw( name from, name receiver,
                         asset stake_net_quantity, asset stake_cpu_quantity, bool transfer );
 
+         //defined in producer_pay.cpp
+         void fold_unpaid_blocks();
+
          //defined in voting.hpp
          void update_elected_producers( block_timestamp timestamp );
          void update_votes( const name voter, const name proxy, const std::vector<name>& producers, bool voting );
 
          // defined in voting.cpp
-         void propagate_weight_change( const voter_info& voter );
+         /// vote weight change of a producer and where it comes from
+         struct producer_vote_delta {
+            double votes        = 0;
+            bool   voted        = false;  ///< in the old or new producers of the voter
+            bool   from_new_set = false;  ///< in the new producers of the voter
+            bool   proxied      = false;  ///< in the producers of a proxy the weight change went through
+         };
+         typedef boost::container::flat_map< name, producer_vote_delta > producer_vote_deltas;
+
+         double stake2vote( int64_t staked );
+         uint64_t producer_slot_of( name producer );
+         void update_slot_voters( const producer_slot& s, int64_t delta );
+         std::vector<name> voted_producers( const voter_info& voter );
+         void propagate_weight_change( const voter_info& voter, producer_vote_deltas& producer_deltas );
+         void apply_producer_deltas( const producer_vote_deltas& producer_deltas, bool voting );
 
          double update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
                                                time_point ct,
@@ -1,12 +1,18 @@
 #pragma once
 
 #include <eosiolib/asset.hpp>
+#include <eosio.system/bancor.hpp>
 
 namespace eosiosystem {
    using eosio::asset;
    using eosio::symbol;
 
+   /// number type of the Bancor math, build with EOSIO_SYSTEM_FIXED_POINT_BANCOR for the deterministic fixed_point
+#ifdef EOSIO_SYSTEM_FIXED_POINT_BANCOR
+   typedef fixed_point real_type;
+#else
    typedef double real_type;
+#endif
 
    /**
     *  Uses Bancor math to create a 50/50 relay between two asset types. The state of the
@@ -32,6 +38,11 @@ namespace eosiosystem {
       asset convert_from_exchange( connector& c, asset in );
       asset convert( asset from, const symbol& to );
 
+      /// base connector tokens that `in` quote connector tokens would buy, without changing the market
+      asset quote_buy( const asset& in )const;
+      /// quote connector tokens that selling `in` base connector tokens would return, without changing the market
+      asset quote_sell( const asset& in )const;
+
       EOSLIB_SERIALIZE( exchange_state, (supply)(base)(quote) )
    };
 
@@ -0,0 +1,211 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace eosiosystem {
+
+   /**
+    *  Signed fixed point number with 64 integer and 64 fraction bits, for deterministic Bancor math
+    *  without the soft-float double path of WASM. It depends on nothing but the compiler so that the
+    *  same code can be checked natively against double.
+    *
+    *  Results are truncated toward zero like int64_t(double). Overflow of the integer part is not
+    *  detected, callers keep their values in the range of int64_t.
+    */
+   class fixed_point {
+      public:
+         constexpr fixed_point() = default;
+         constexpr fixed_point( int64_t i ) : v( __int128(i) * one_raw ) {}
+         explicit fixed_point( double d ) : v( from_double( d ) ) {}
+
+         static constexpr fixed_point from_raw( __int128 raw ) { fixed_point f; f.v = raw; return f; }
+         constexpr __int128 raw()const { return v; }
+
+         explicit constexpr operator int64_t()const {
+            return v >= 0 ? int64_t( v / one_raw ) : -int64_t( -v / one_raw );
+         }
+
+         friend constexpr fixed_point operator+( fixed_point a, fixed_point b ) { return from_raw( a.v + b.v ); }
+         friend constexpr fixed_point operator-( fixed_point a, fixed_point b ) { return from_raw( a.v - b.v ); }
+         friend constexpr fixed_point operator-( fixed_point a )                { return from_raw( -a.v ); }
+         friend constexpr fixed_point operator*( fixed_point a, fixed_point b ) { return from_raw( mul_raw( a.v, b.v ) ); }
+         friend constexpr fixed_point operator/( fixed_point a, fixed_point b ) { return from_raw( div_raw( a.v, b.v ) ); }
+
+         friend constexpr bool operator==( fixed_point a, fixed_point b ) { return a.v == b.v; }
+         friend constexpr bool operator!=( fixed_point a, fixed_point b ) { return a.v != b.v; }
+         friend constexpr bool operator<( fixed_point a, fixed_point b )  { return a.v < b.v;  }
+
+         /// base 2 logarithm, `x` must be positive
+         static fixed_point log2( fixed_point x ) {
+            const auto u = static_cast<unsigned __int128>( x.v );
+            const int  p = msb( u );
+            // mantissa in [1,2), split into the table entry 1 + j/64 and a remainder 1 + y with |y| < 1/64
+            const unsigned __int128 m = p >= 64 ? u >> (p - 64) : u << (64 - p);
+            const unsigned j = unsigned( uint64_t(m) >> 58 );
+            const __int128 y = j == 0 ? __int128( uint64_t(m) )
+                                      : mul_raw( __int128(m), __int128( recip_table[j] ) ) - one_raw;
+
+            // ln(1 + y) = y - y^2/2 + y^3/3 - ...
+            __int128 ln = 0;
+            __int128 term = y;
+            for( int k = 1; k <= 12; ++k ) {
+               ln += (k & 1) ? term / k : -(term / k);
+               term = mul_raw( term, y );
+            }
+            return from_raw( __int128(p - 64) * one_raw + __int128( log2_table[j] ) + mul_raw( ln, log2e_raw ) );
+         }
+
+         /// 2 raised to `z`, the result must stay below 2^63
+         static fixed_point exp2( fixed_point z ) {
+            __int128 n = z.v / one_raw;
+            if( z.v < n * one_raw )
+               --n;
+            // fraction in [0,1), split into the table entry j/64 and a remainder r < 1/64
+            const uint64_t f = uint64_t( z.v - n * one_raw );
+            const unsigned j = unsigned( f >> 58 );
+            const __int128 t = mul_raw( __int128( f & ((uint64_t(1) << 58) - 1) ), ln2_raw );
+
+            // e^(r ln 2) = 1 + t + t^2/2! + ...
+            __int128 e    = one_raw;
+            __int128 term = one_raw;
+            for( int k = 1; k <= 10; ++k ) {
+               term = mul_raw( term, t ) / k;
+               e += term;
+            }
+            const __int128 r = mul_raw( one_raw + __int128( exp2_table[j] ), e );
+            if( n >= 0 )
+               return from_raw( __int128( static_cast<unsigned __int128>(r) << int(n) ) );
+            return from_raw( n <= -127 ? 0 : r >> int(-n) );
+         }
+
+      private:
+         static constexpr __int128 one_raw   = __int128(1) << 64;
+         static constexpr __int128 ln2_raw   = __int128( 0xb17217f7d1cf79acull );                 ///< ln(2)
+         static constexpr __int128 log2e_raw = one_raw + __int128( 0x71547652b82fe177ull );       ///< 1/ln(2)
+
+         /// log2(1 + j/64)
+         static constexpr uint64_t log2_table[64] = {
+         0x0000000000000000ull, 0x05b9e5a170b48a63ull, 0x0b5d69bac77ec399ull, 0x10eb389fa29f9ab4ull,
+         0x1663f6fac913167dull, 0x1bc84240adabba64ull, 0x2118b119b4f3c72cull, 0x2655d3c4f15c343full,
+         0x2b803473f7ad0f3full, 0x309857a05e0765fcull, 0x359ebc5b69d927e0ull, 0x3a93dc9864b2df92ull,
+         0x3f782d7204d01447ull, 0x444c1f6b4c2dd72cull, 0x49101eac381ce609ull, 0x4dc4933a9337b366ull,
+         0x5269e12f346e2bf9ull, 0x570068e7ef5a1e7full, 0x5b8887367433795eull, 0x6002958c587150cbull,
+         0x646eea247c5c22d3ull, 0x68cdd829fd814276ull, 0x6d1fafdce20a8290ull, 0x7164beb4a56d59faull,
+         0x759d4f80cba83bf9ull, 0x79c9aa879d534831ull, 0x7dea15a32c1b3b38ull, 0x81fed45cbccbf99dull,
+         0x86082806b1d532c4ull, 0x8a064fd50f2a1cf1ull, 0x8df988f4ae806f1eull, 0x91e20ea1393e4040ull,
+         0x95c01a39fbd687a0ull, 0x9993e355a4e53643ull, 0x9d5d9fd5010b3666ull, 0xa11d83f4c3554b38ull,
+         0xa4d3c25e68dc57f2ull, 0xa8808c384547c6efull, 0xac241134c4e99e1cull, 0xafbe7fa0f04d75c6ull,
+         0xb35004723c465e69ull, 0xb6d8cb53b0ca4eccull, 0xba58feb2703a9e37ull, 0xbdd0c7c9a817204full,
+         0xc1404eadf38396dfull, 0xc4a7ba58377c5a03ull, 0xc80730b0001667f2ull, 0xcb5ed69565afaf7full,
+         0xceaecfea80859b33ull, 0xd1f73f9c70c0f684ull, 0xd53847ac00a69be7ull, 0xd8720935e6435ebdull,
+         0xdba4a47aa996d25aull, 0xded038e633f36da9ull, 0xe1f4e5170d02a99bull, 0xe512c6e54998b1b0ull,
+         0xe829fb693044b399ull, 0xeb3a9f01975077f2ull, 0xee44cd59ffab62f3ull, 0xf148a170700a00feull,
+         0xf446359b13539551ull, 0xf73da38d9d4a83ebull, 0xfa2f045e7832aa72ull, 0xfd1a708bbe119b15ull
+         };
+
+         /// 1/(1 + j/64), the first entry is unused
+         static constexpr uint64_t recip_table[64] = {
+         0x0000000000000000ull, 0xfc0fc0fc0fc0fc10ull, 0xf83e0f83e0f83e10ull, 0xf4898d5f85bb3950ull,
+         0xf0f0f0f0f0f0f0f1ull, 0xed7303b5cc0ed730ull, 0xea0ea0ea0ea0ea0full, 0xe6c2b4481cd85689ull,
+         0xe38e38e38e38e38eull, 0xe070381c0e070382ull, 0xdd67c8a60dd67c8aull, 0xda740da740da740eull,
+         0xd79435e50d79435eull, 0xd4c77b03531dec0dull, 0xd20d20d20d20d20dull, 0xcf6474a8819ec8e9ull,
+         0xcccccccccccccccdull, 0xca4587e6b74f0329ull, 0xc7ce0c7ce0c7ce0cull, 0xc565c87b5f9d4d1cull,
+         0xc30c30c30c30c30cull, 0xc0c0c0c0c0c0c0c1ull, 0xbe82fa0be82fa0bfull, 0xbc52640bc52640bcull,
+         0xba2e8ba2e8ba2e8cull, 0xb81702e05c0b8170ull, 0xb60b60b60b60b60bull, 0xb40b40b40b40b40bull,
+         0xb21642c8590b2164ull, 0xb02c0b02c0b02c0bull, 0xae4c415c9882b931ull, 0xac7691840ac76918ull,
+         0xaaaaaaaaaaaaaaabull, 0xa8e83f5717c0a8e8ull, 0xa72f05397829cbc1ull, 0xa57eb50295fad40aull,
+         0xa3d70a3d70a3d70aull, 0xa237c32b16cfd772ull, 0xa0a0a0a0a0a0a0a1ull, 0x9f1165e7254813e2ull,
+         0x9d89d89d89d89d8aull, 0x9c09c09c09c09c0aull, 0x9a90e7d95bc609a9ull, 0x991f1a515885fb37ull,
+         0x97b425ed097b425full, 0x964fda6c0964fda7ull, 0x94f2094f2094f209ull, 0x939a85c40939a85cull,
+         0x9249249249249249ull, 0x90fdbc090fdbc091ull, 0x8fb823ee08fb823full, 0x8e78356d1408e783ull,
+         0x8d3dcb08d3dcb08dull, 0x8c08c08c08c08c09ull, 0x8ad8f2fba9386823ull, 0x89ae4089ae4089aeull,
+         0x8888888888888889ull, 0x8767ab5f34e47ef1ull, 0x864b8a7de6d1d608ull, 0x8534085340853408ull,
+         0x8421084210842108ull, 0x83126e978d4fdf3bull, 0x8208208208208208ull, 0x8102040810204081ull
+         };
+
+         /// 2^(j/64) - 1
+         static constexpr uint64_t exp2_table[64] = {
+         0x0000000000000000ull, 0x02c9a3e778060ee7ull, 0x059b0d31585743aeull, 0x0874518759bc808cull,
+         0x0b5586cf9890f62aull, 0x0e3ec32d3d1a2020ull, 0x11301d0125b50a4full, 0x1429aaea92ddfb34ull,
+         0x172b83c7d517adceull, 0x1a35beb6fcb753cbull, 0x1d4873168b9aa780ull, 0x2063b88628cd63b9ull,
+         0x2387a6e75623866cull, 0x26b4565e27cdd258ull, 0x29e9df51fdee12c2ull, 0x2d285a6e4030b401ull,
+         0x306fe0a31b7152dfull, 0x33c08b26416ff4caull, 0x371a7373aa9caa71ull, 0x3a7db34e59ff6ea2ull,
+         0x3dea64c12342235bull, 0x4160a21f72e29f84ull, 0x44e086061892d031ull, 0x486a2b5c13cd013cull,
+         0x4bfdad5362a271d4ull, 0x4f9b2769d2ca6ad3ull, 0x5342b569d4f81df1ull, 0x56f4736b527da66full,
+         0x5ab07dd48542958dull, 0x5e76f15ad21486eaull, 0x6247eb03a5584b1full, 0x6623882552224912ull,
+         0x6a09e667f3bcc909ull, 0x6dfb23c651a2ef22ull, 0x71f75e8ec5f73dd2ull, 0x75feb564267c8bf7ull,
+         0x7a11473eb0186d7dull, 0x7e2f336cf4e62106ull, 0x82589994cce128adull, 0x868d99b4492ec80eull,
+         0x8ace5422aa0db5baull, 0x8f1ae991577362baull, 0x93737b0cdc5e4f45ull, 0x97d829fde4e4f8baull,
+         0x9c49182a3f0901c8ull, 0xa0c667b5de564b2aull, 0xa5503b23e255c8b4ull, 0xa9e6b5579fdbf43full,
+         0xae89f995ad3ad5e8ull, 0xb33a2b84f15faf6cull, 0xb7f76f2fb5e46eaaull, 0xbcc1e904bc1d2248ull,
+         0xc199bdd85529c222ull, 0xc67f12e57d14b4a2ull, 0xcb720dcef9069150ull, 0xd072d4a07897b8d1ull,
+         0xd5818dcfba48725eull, 0xda9e603db3285709ull, 0xdfc97337b9b5eb97ull, 0xe502ee78b3ff6274ull,
+         0xea4afa2a490d9859ull, 0xefa1bee615a27772ull, 0xf50765b6e4540675ull, 0xfa7c1819e90d82e9ull
+         };
+
+         __int128 v = 0;
+
+         static constexpr int msb( unsigned __int128 u ) {
+            const uint64_t hi = uint64_t( u >> 64 );
+            return hi ? 127 - __builtin_clzll( hi ) : 63 - __builtin_clzll( uint64_t(u) );
+         }
+
+         static constexpr __int128 mul_raw( __int128 a, __int128 b ) {
+            const bool neg = (a < 0) != (b < 0);
+            const auto x = a < 0 ? -static_cast<unsigned __int128>(a) : static_cast<unsigned __int128>(a);
+            const auto y = b < 0 ? -static_cast<unsigned __int128>(b) : static_cast<unsigned __int128>(b);
+            const uint64_t xh = uint64_t( x >> 64 ), xl = uint64_t( x );
+            const uint64_t yh = uint64_t( y >> 64 ), yl = uint64_t( y );
+            const unsigned __int128 r = ( static_cast<unsigned __int128>(xh) * yh << 64 )
+                                      + static_cast<unsigned __int128>(xh) * yl
+                                      + static_cast<unsigned __int128>(xl) * yh
+                                      + ( static_cast<unsigned __int128>(xl) * yl >> 64 );
+            return neg ? -__int128(r) : __int128(r);
+         }
+
+         static constexpr __int128 div_raw( __int128 a, __int128 b ) {
+            const bool neg = (a < 0) != (b < 0);
+            const auto x = a < 0 ? -static_cast<unsigned __int128>(a) : static_cast<unsigned __int128>(a);
+            const auto y = b < 0 ? -static_cast<unsigned __int128>(b) : static_cast<unsigned __int128>(b);
+            // integer part by native division, then the 64 fraction bits by long division
+            unsigned __int128 q   = x / y;
+            unsigned __int128 rem = x % y;
+            for( int i = 0; i < 64; ++i ) {
+               rem <<= 1;
+               q   <<= 1;
+               if( rem >= y ) {
+                  rem -= y;
+                  q   |= 1;
+               }
+            }
+            return neg ? -__int128(q) : __int128(q);
+         }
+
+         static __int128 from_double( double d ) {
+            uint64_t bits;
+            std::memcpy( &bits, &d, sizeof(bits) );
+            const int      exponent = int( (bits >> 52) & 0x7ff );
+            const uint64_t mantissa = ( bits & ((uint64_t(1) << 52) - 1) ) | (uint64_t(1) << 52);
+            if( exponent == 0 )
+               return 0;
+            // d = mantissa * 2^(exponent - 1075), shifted by 64 fraction bits
+            const int shift = exponent - 1075 + 64;
+            unsigned __int128 r = mantissa;
+            if( shift >= 0 )
+               r <<= shift;
+            else
+               r = shift <= -64 ? 0 : r >> -shift;
+            return (bits >> 63) ? -__int128(r) : __int128(r);
+         }
+   };
+
+   inline fixed_point pow( fixed_point base, fixed_point exponent ) {
+      return fixed_point::exp2( exponent * fixed_point::log2( base ) );
+   }
+
+} /// namespace eosiosystem
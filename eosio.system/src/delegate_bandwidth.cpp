@@ -28,7 +28,6 @@ namespace eosiosystem {
    using std::map;
    using std::pair;
 
-   static constexpr uint32_t refund_delay_sec = 0;
    static constexpr int64_t  ram_gift_bytes = 1400;
 
    struct [[eosio::table, eosio::contract("eosio.system")]] user_resources {
@@ -87,9 +86,8 @@ namespace eosiosystem {
     */
    void system_contract::buyrambytes( name payer, name receiver, uint32_t bytes ) {
       eosio_assert( false, "Chain does not support buyrambytes" );
-      auto itr = _rammarket.find(ramcore_symbol.raw());
-      auto tmp = *itr;
-      auto eosout = tmp.convert( asset(bytes, ram_symbol), core_symbol() );
+      const auto& market = _rammarket.get(ramcore_symbol.raw(), "ram market does not exist");
+      auto eosout = market.quote_sell( asset(bytes, ram_symbol) );
 
       buyram( payer, receiver, eosout );
    }
@@ -143,8 +141,8 @@ namespace eosiosystem {
 
       eosio_assert( bytes_out > 0, "must reserve a positive amount" );
 
-      _gstate.total_ram_bytes_reserved += uint64_t(bytes_out);
-      _gstate.total_ram_stake          += quant_after_fee.amount;
+      gstate().total_ram_bytes_reserved += uint64_t(bytes_out);
+      gstate().total_ram_stake          += quant_after_fee.amount;
 
       user_resources_table  userres( _self, receiver.value );
       auto res_itr = userres.find( receiver.value );
@@ -169,6 +167,26 @@ namespace eosiosystem {
       }
    }
 
+   /**
+    *  Prints the outcome of buyram for `quant` of the core token, or of sellram for `quant` RAM bytes,
+    *  at the current market price and after the .5% fee. Nothing is modified, so quotes can be batched
+    *  in a transaction that is only evaluated and never broadcast.
+    */
+   void system_contract::quoteram( asset quant ) {
+      eosio_assert( quant.amount > 0, "must quote a positive amount" );
+
+      const auto& market = _rammarket.get(ramcore_symbol.raw(), "ram market does not exist");
+      if( quant.symbol == ram_symbol ) {
+         auto tokens_out = market.quote_sell( quant );
+         tokens_out.amount -= ( tokens_out.amount + 199 ) / 200; /// .5% fee (round up)
+         print( tokens_out, "\n" );
+      } else {
+         eosio_assert( quant.symbol == core_symbol(), "must quote core token or RAM bytes" );
+         quant.amount -= ( quant.amount + 199 ) / 200; /// .5% fee (round up)
+         print( market.quote_buy( quant ), "\n" );
+      }
+   }
+
   /**
     *  The system contract now buys and sells RAM allocations at prevailing market prices.
     *  This may result in traders buying RAM today in anticipation of potential shortages
@@ -196,11 +214,11 @@ namespace eosiosystem {
 
       eosio_assert( tokens_out.amount > 1, "token amount received from selling ram is too low" );
 
-      _gstate.total_ram_bytes_reserved -= static_cast<decltype(_gstate.total_ram_bytes_reserved)>(bytes); // bytes > 0 is asserted above
-      _gstate.total_ram_stake          -= tokens_out.amount;
+      gstate().total_ram_bytes_reserved -= static_cast<decltype(gstate().total_ram_bytes_reserved)>(bytes); // bytes > 0 is asserted above
+      gstate().total_ram_stake          -= tokens_out.amount;
 
       //// this shouldn't happen, but just in case it does we should prevent it
-      eosio_assert( _gstate.total_ram_stake >= 0, "error, attempt to unstake more tokens than previously staked" );
+      eosio_assert( gstate().total_ram_stake >= 0, "error, attempt to unstake more tokens than previously staked" );
 
       userres.modify( res_itr, account, [&]( auto& res ) {
           res.ram_bytes -= bytes;
@@ -236,6 +254,10 @@ namespace eosiosystem {
       eosio_assert( max_claimable - claimable <= stake, "b1 can only claim their tokens over 10 years" );
    }
 
+   uint32_t system_contract::refund_delay_sec() {
+      return gstate3().refund_delay_sec.value_or( 0 );
+   }
+
    void system_contract::changebw( name from, name receiver,
                                    const asset stake_net_delta, const asset stake_cpu_delta, bool transfer )
    {
@@ -250,75 +272,86 @@ namespace eosiosystem {
          from = receiver;
       }
 
-      // update stake delegated from "from" to "receiver"
+      // each voters row is read once: the resource flags of "receiver" and the stake of "from"
+      // come from the same row when they are the same account
+      auto from_voter     = _voters.find( from.value );
+      auto receiver_voter = receiver == from ? from_voter : _voters.find( receiver.value );
+
+      // update stake delegated from "from" to "receiver", the new weights are computed first so that the row
+      // is written once: emplaced, modified or erased
       {
          del_bandwidth_table     del_tbl( _self, from.value );
          auto itr = del_tbl.find( receiver.value );
-         if( itr == del_tbl.end() ) {
-            itr = del_tbl.emplace( from, [&]( auto& dbo ){
+         const bool exists = itr != del_tbl.end();
+         const asset net_weight = exists ? itr->net_weight + stake_net_delta : stake_net_delta;
+         const asset cpu_weight = exists ? itr->cpu_weight + stake_cpu_delta : stake_cpu_delta;
+         eosio_assert( 0 <= net_weight.amount, "insufficient staked net bandwidth" );
+         eosio_assert( 0 <= cpu_weight.amount, "insufficient staked cpu bandwidth" );
+         if ( net_weight.amount == 0 && cpu_weight.amount == 0 ) {
+            if( exists )
+               del_tbl.erase( itr );
+         } else if( !exists ) {
+            del_tbl.emplace( from, [&]( auto& dbo ){
                   dbo.from          = from;
                   dbo.to            = receiver;
-                  dbo.net_weight    = stake_net_delta;
-                  dbo.cpu_weight    = stake_cpu_delta;
+                  dbo.net_weight    = net_weight;
+                  dbo.cpu_weight    = cpu_weight;
                });
-         }
-         else {
+         } else {
             del_tbl.modify( itr, same_payer, [&]( auto& dbo ){
-                  dbo.net_weight    += stake_net_delta;
-                  dbo.cpu_weight    += stake_cpu_delta;
+                  dbo.net_weight    = net_weight;
+                  dbo.cpu_weight    = cpu_weight;
                });
          }
-         eosio_assert( 0 <= itr->net_weight.amount, "insufficient staked net bandwidth" );
-         eosio_assert( 0 <= itr->cpu_weight.amount, "insufficient staked cpu bandwidth" );
-         if ( itr->net_weight.amount == 0 && itr->cpu_weight.amount == 0 ) {
-            del_tbl.erase( itr );
-         }
       } // itr can be invalid, should go out of scope
 
-      // update totals of "receiver"
+      // update totals of "receiver", written once after the new totals and resource limits are known
       {
          user_resources_table   totals_tbl( _self, receiver.value );
          auto tot_itr = totals_tbl.find( receiver.value );
-         if( tot_itr ==  totals_tbl.end() ) {
-            tot_itr = totals_tbl.emplace( from, [&]( auto& tot ) {
-                  tot.owner = receiver;
-                  tot.net_weight    = stake_net_delta;
-                  tot.cpu_weight    = stake_cpu_delta;
-               });
-         } else {
-            totals_tbl.modify( tot_itr, from == receiver ? from : same_payer, [&]( auto& tot ) {
-                  tot.net_weight    += stake_net_delta;
-                  tot.cpu_weight    += stake_cpu_delta;
-               });
-         }
-         eosio_assert( 0 <= tot_itr->net_weight.amount, "insufficient staked total net bandwidth" );
-         eosio_assert( 0 <= tot_itr->cpu_weight.amount, "insufficient staked total cpu bandwidth" );
+         const bool exists = tot_itr != totals_tbl.end();
+         const asset   net_weight = exists ? tot_itr->net_weight + stake_net_delta : stake_net_delta;
+         const asset   cpu_weight = exists ? tot_itr->cpu_weight + stake_cpu_delta : stake_cpu_delta;
+         const int64_t ram_bytes  = exists ? tot_itr->ram_bytes : 0;
+         eosio_assert( 0 <= net_weight.amount, "insufficient staked total net bandwidth" );
+         eosio_assert( 0 <= cpu_weight.amount, "insufficient staked total cpu bandwidth" );
 
          {
             bool ram_managed = false;
             bool net_managed = false;
             bool cpu_managed = false;
 
-            auto voter_itr = _voters.find( receiver.value );
-            if( voter_itr != _voters.end() ) {
-               ram_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::ram_managed );
-               net_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::net_managed );
-               cpu_managed = has_field( voter_itr->flags1, voter_info::flags1_fields::cpu_managed );
+            if( receiver_voter != _voters.end() ) {
+               ram_managed = has_field( receiver_voter->flags1, voter_info::flags1_fields::ram_managed );
+               net_managed = has_field( receiver_voter->flags1, voter_info::flags1_fields::net_managed );
+               cpu_managed = has_field( receiver_voter->flags1, voter_info::flags1_fields::cpu_managed );
             }
 
             if( !(net_managed && cpu_managed) ) {
-               int64_t ram_bytes, net, cpu;
-               get_resource_limits( receiver.value, &ram_bytes, &net, &cpu );
+               int64_t ram, net, cpu;
+               get_resource_limits( receiver.value, &ram, &net, &cpu );
 
                set_resource_limits( receiver.value,
-                                    ram_managed ? ram_bytes : std::max( tot_itr->ram_bytes, ram_bytes ),
-                                    net_managed ? net : tot_itr->net_weight.amount,
-                                    cpu_managed ? cpu : tot_itr->cpu_weight.amount );
+                                    ram_managed ? ram : std::max( ram_bytes, ram ),
+                                    net_managed ? net : net_weight.amount,
+                                    cpu_managed ? cpu : cpu_weight.amount );
             }
          }
 
-         if ( tot_itr->net_weight.amount == 0 && tot_itr->cpu_weight.amount == 0  && tot_itr->ram_bytes == 0 ) {
-            totals_tbl.erase( tot_itr );
+         if ( net_weight.amount == 0 && cpu_weight.amount == 0 && ram_bytes == 0 ) {
+            if( exists )
+               totals_tbl.erase( tot_itr );
+         } else if( !exists ) {
+            totals_tbl.emplace( from, [&]( auto& tot ) {
+                  tot.owner = receiver;
+                  tot.net_weight    = net_weight;
+                  tot.cpu_weight    = cpu_weight;
+               });
+         } else {
+            totals_tbl.modify( tot_itr, from == receiver ? from : same_payer, [&]( auto& tot ) {
+                  tot.net_weight    = net_weight;
+                  tot.cpu_weight    = cpu_weight;
+               });
          }
       } // tot_itr can be invalid, should go out of scope
 
@@ -331,12 +364,16 @@ namespace eosiosystem {
          auto net_balance = stake_net_delta;
          auto cpu_balance = stake_cpu_delta;
          bool need_deferred_trx = false;
+         const bool had_refund = req != refunds_tbl.end();
+         asset refund_now( 0, core_symbol() );
 
 
          // net and cpu are same sign by assertions in delegatebw and undelegatebw
          // redundant assertion also at start of changebw to protect against misuse of changebw
          bool is_undelegating = (net_balance.amount + cpu_balance.amount ) < 0;
          bool is_delegating_to_self = (!transfer && from == receiver);
+         // global3 is only read when a refund can be created, updated or paid out
+         const uint32_t delay_sec = ( is_undelegating || had_refund ) ? refund_delay_sec() : 0;
 
          if( is_delegating_to_self || is_undelegating ) {
             if ( req != refunds_tbl.end() ) { //need to update refund
@@ -369,6 +406,15 @@ namespace eosiosystem {
                } else {
                   need_deferred_trx = true;
                }
+            } else if ( delay_sec == 0 && ( net_balance.amount < 0 || cpu_balance.amount < 0 ) ) { //refund right away
+               if ( net_balance.amount < 0 ) {
+                  refund_now -= net_balance;
+                  net_balance.amount = 0;
+               }
+               if ( cpu_balance.amount < 0 ) {
+                  refund_now -= cpu_balance;
+                  cpu_balance.amount = 0;
+               }
             } else if ( net_balance.amount < 0 || cpu_balance.amount < 0 ) { //need to create refund
                refunds_tbl.emplace( from, [&]( refund_request& r ) {
                   r.owner = from;
@@ -390,19 +436,33 @@ namespace eosiosystem {
             } // else stake increase requested with no existing row in refunds_tbl -> nothing to do with refunds_tbl
          } /// end if is_delegating_to_self || is_undelegating
 
+         // a refund requested while refunds were delayed is due once the delay is 0
+         if ( need_deferred_trx && delay_sec == 0 ) {
+            refund_now += req->net_amount + req->cpu_amount;
+            refunds_tbl.erase( req );
+            need_deferred_trx = false;
+         }
+
          if ( need_deferred_trx ) {
             eosio::transaction out;
             out.actions.emplace_back( permission_level{from, active_permission},
                                       _self, "refund"_n,
                                       from
             );
-            out.delay_sec = refund_delay_sec;
+            out.delay_sec = delay_sec;
             cancel_deferred( from.value ); // TODO: Remove this line when replacing deferred trxs is fixed
             out.send( from.value, from, true );
-         } else {
+         } else if ( had_refund ) {
             cancel_deferred( from.value );
          }
 
+         if ( 0 < refund_now.amount ) {
+            INLINE_ACTION_SENDER(eosio::token, transfer)(
+               token_account, { {stake_account, active_permission}, {from, active_permission} },
+               { stake_account, from, refund_now, std::string("unstake") }
+            );
+         }
+
          auto transfer_amount = net_balance + cpu_balance;
          if ( 0 < transfer_amount.amount ) {
             INLINE_ACTION_SENDER(eosio::token, transfer)(
@@ -415,7 +475,6 @@ namespace eosiosystem {
       // update voting power
       {
          asset total_update = stake_net_delta + stake_cpu_delta;
-         auto from_voter = _voters.find( from.value );
          if( from_voter == _voters.end() ) {
             from_voter = _voters.emplace( from, [&]( auto& v ) {
                   v.owner  = from;
@@ -431,8 +490,8 @@ namespace eosiosystem {
             validate_b1_vesting( from_voter->staked );
          }
 
-         if( from_voter->producers.size() || from_voter->proxy ) {
-            update_votes( from, from_voter->proxy, from_voter->producers, false );
+         if( from_voter->has_producer_votes() || from_voter->proxy ) {
+            update_votes( from, from_voter->proxy, voted_producers( *from_voter ), false );
          }
       }
    }
@@ -457,7 +516,7 @@ namespace eosiosystem {
       eosio_assert( unstake_cpu_quantity >= zero_asset, "must unstake a positive amount" );
       eosio_assert( unstake_net_quantity >= zero_asset, "must unstake a positive amount" );
       eosio_assert( unstake_cpu_quantity.amount + unstake_net_quantity.amount > 0, "must unstake a positive amount" );
-      //eosio_assert( _gstate.total_activated_stake >= min_activated_stake,
+      //eosio_assert( gstate().total_activated_stake >= min_activated_stake,
       //              "cannot undelegate bandwidth until the chain is activated (at least 15% of all tokens participate in voting)" );
 
       changebw( from, receiver, -unstake_net_quantity, -unstake_cpu_quantity, false);
@@ -470,7 +529,7 @@ namespace eosiosystem {
       refunds_table refunds_tbl( _self, owner.value );
       auto req = refunds_tbl.find( owner.value );
       eosio_assert( req != refunds_tbl.end(), "refund request not found" );
-      eosio_assert( req->request_time + seconds(refund_delay_sec) <= current_time_point(),
+      eosio_assert( req->request_time + seconds(refund_delay_sec()) <= current_time_point(),
                     "refund is not available yet" );
 
       INLINE_ACTION_SENDER(eosio::token, transfer)(
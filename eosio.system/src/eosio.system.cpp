@@ -18,6 +18,7 @@ namespace eosiosystem {
     _voters(_self, _self.value),
     _producers(_self, _self.value),
     _producers2(_self, _self.value),
+    _producer_slots(_self, _self.value),
     _global(_self, _self.value),
     _global2(_self, _self.value),
     _global3(_self, _self.value),
@@ -25,9 +26,6 @@ namespace eosiosystem {
    {
 
       //print( "construct system\n" );
-      _gstate  = _global.exists() ? _global.get() : get_default_parameters();
-      _gstate2 = _global2.exists() ? _global2.get() : eosio_global_state2{};
-      _gstate3 = _global3.exists() ? _global3.get() : eosio_global_state3{};
    }
 
    eosio_global_state system_contract::get_default_parameters() {
@@ -51,21 +49,61 @@ namespace eosiosystem {
       return sym;
    }
 
+   /**
+    *  The global states are read on first use only. The serialized form of a loaded row is kept so that
+    *  the destructor writes back only what changed; a missing row keeps an empty snapshot and is created.
+    */
+   eosio_global_state& system_contract::gstate() {
+      if( !_gstate ) {
+         if( _global.exists() ) {
+            _gstate = _global.get();
+            _gstate_packed = eosio::pack( *_gstate );
+         } else {
+            _gstate = get_default_parameters();
+         }
+      }
+      return *_gstate;
+   }
+
+   eosio_global_state2& system_contract::gstate2() {
+      if( !_gstate2 ) {
+         if( _global2.exists() ) {
+            _gstate2 = _global2.get();
+            _gstate2_packed = eosio::pack( *_gstate2 );
+         } else {
+            _gstate2.emplace();
+         }
+      }
+      return *_gstate2;
+   }
+
+   eosio_global_state3& system_contract::gstate3() {
+      if( !_gstate3 ) {
+         if( _global3.exists() ) {
+            _gstate3 = _global3.get();
+            _gstate3_packed = eosio::pack( *_gstate3 );
+         } else {
+            _gstate3.emplace();
+         }
+      }
+      return *_gstate3;
+   }
+
    system_contract::~system_contract() {
-      _global.set( _gstate, _self );
-      _global2.set( _gstate2, _self );
-      _global3.set( _gstate3, _self );
+      if( _gstate )  save_if_changed( _global,  *_gstate,  _gstate_packed );
+      if( _gstate2 ) save_if_changed( _global2, *_gstate2, _gstate2_packed );
+      if( _gstate3 ) save_if_changed( _global3, *_gstate3, _gstate3_packed );
    }
 
    void system_contract::setram( uint64_t max_ram_size ) {
       eosio_assert( false, "Chain does not support setram" );
       require_auth( _self );
 
-      eosio_assert( _gstate.max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
+      eosio_assert( gstate().max_ram_size < max_ram_size, "ram may only be increased" ); /// decreasing ram might result market maker issues
       eosio_assert( max_ram_size < 1024ll*1024*1024*1024*1024, "ram size is unrealistic" );
-      eosio_assert( max_ram_size > _gstate.total_ram_bytes_reserved, "attempt to set max below reserved" );
+      eosio_assert( max_ram_size > gstate().total_ram_bytes_reserved, "attempt to set max below reserved" );
 
-      auto delta = int64_t(max_ram_size) - int64_t(_gstate.max_ram_size);
+      auto delta = int64_t(max_ram_size) - int64_t(gstate().max_ram_size);
       auto itr = _rammarket.find(ramcore_symbol.raw());
 
       /**
@@ -75,17 +113,17 @@ namespace eosiosystem {
          m.base.balance.amount += delta;
       });
 
-      _gstate.max_ram_size = max_ram_size;
+      gstate().max_ram_size = max_ram_size;
    }
 
    void system_contract::update_ram_supply() {
       auto cbt = current_block_time();
 
-      if( cbt <= _gstate2.last_ram_increase ) return;
+      if( cbt <= gstate2().last_ram_increase ) return;
 
       auto itr = _rammarket.find(ramcore_symbol.raw());
-      auto new_ram = (cbt.slot - _gstate2.last_ram_increase.slot)*_gstate2.new_ram_per_block;
-      _gstate.max_ram_size += new_ram;
+      auto new_ram = (cbt.slot - gstate2().last_ram_increase.slot)*gstate2().new_ram_per_block;
+      gstate().max_ram_size += new_ram;
 
       /**
        *  Increase the amount of ram for sale based upon the change in max ram size.
@@ -93,7 +131,7 @@ namespace eosiosystem {
       _rammarket.modify( itr, same_payer, [&]( auto& m ) {
          m.base.balance.amount += new_ram;
       });
-      _gstate2.last_ram_increase = cbt;
+      gstate2().last_ram_increase = cbt;
    }
 
    /**
@@ -108,13 +146,23 @@ namespace eosiosystem {
       require_auth( _self );
 
       update_ram_supply();
-      _gstate2.new_ram_per_block = bytes_per_block;
+      gstate2().new_ram_per_block = bytes_per_block;
+   }
+
+   void system_contract::setrefdelay( uint32_t delay_sec ) {
+      require_auth( _self );
+      eosio_assert( delay_sec <= gstate().max_transaction_delay, "refund delay exceeds the maximum transaction delay" );
+
+      // extensions are serialized in order, so the one before has to be present
+      if( !gstate3().last_proposed_schedule_hash.has_value() )
+         gstate3().last_proposed_schedule_hash.emplace();
+      gstate3().refund_delay_sec.emplace( delay_sec );
    }
 
    void system_contract::setparams( const eosio::blockchain_parameters& params ) {
       require_auth( _self );
-      (eosio::blockchain_parameters&)(_gstate) = params;
-      eosio_assert( 3 <= _gstate.max_authority_depth, "max_authority_depth should be at least 3" );
+      (eosio::blockchain_parameters&)(gstate()) = params;
+      eosio_assert( 3 <= gstate().max_authority_depth, "max_authority_depth should be at least 3" );
       set_blockchain_parameters( params );
    }
 
@@ -138,6 +186,11 @@ namespace eosiosystem {
          eosio_assert( !(ram_managed || net_managed || cpu_managed), "cannot use setalimits on an account with managed resources" );
       }
 
+      // newaccount leaves sidechain accounts at zero limits without a userres row, they are managed through setacctram/net/cpu
+      int64_t current_ram, current_net, current_cpu;
+      get_resource_limits( account.value, &current_ram, &current_net, &current_cpu );
+      eosio_assert( current_ram != 0 || current_net != 0 || current_cpu != 0, "cannot use setalimits on a sidechain account" );
+
       set_resource_limits( account.value, ram, net, cpu );
    }
 
@@ -178,6 +231,12 @@ namespace eosiosystem {
          ram = *ram_bytes;
       }
 
+      // let eosio.token decide on RAM token transfers without reading the voters table
+      INLINE_ACTION_SENDER(eosio::token, setrammanage)(
+         token_account, { {_self, active_permission} },
+         { account, ram_bytes.has_value() }
+      );
+
       set_resource_limits( account.value, ram, current_net, current_cpu );
    }
 
@@ -269,6 +328,122 @@ namespace eosiosystem {
       set_resource_limits( account.value, current_ram, current_net, cpu );
    }
 
+   void system_contract::setacctres( const std::vector<account_resources>& accounts ) {
+      require_auth( _self );
+      eosio_assert( accounts.size() > 0, "no accounts specified" );
+
+      for( const auto& r : accounts ) {
+         // all three limits are replaced, so the current ones are not read
+         int64_t ram = 0, net = 0, cpu = 0;
+
+         auto vitr = _voters.find( r.account.value );
+         const bool has_voter = vitr != _voters.end();
+         const uint32_t old_flags = has_voter ? vitr->flags1 : 0;
+         uint32_t flags = old_flags;
+
+         if( !r.ram_bytes ) {
+            // eosio.token treats an account without voters row as RAM managed, newaccounts relies on this
+            eosio_assert( !has_voter || has_field( flags, voter_info::flags1_fields::ram_managed ),
+                          "RAM of account is already unmanaged" );
+
+            // a new account has no RAM balance row yet, which reads as zero
+            auto ram_balance = eosio::token::get_balances("eosio.token"_n, r.account, { symbol_code("RAM") }).front();
+            ram = ram_balance_to_bytes(ram_balance);
+         } else {
+            eosio_assert( *r.ram_bytes >= 0, "not allowed to set RAM limit to unlimited" );
+            ram = *r.ram_bytes;
+         }
+         flags = set_field( flags, voter_info::flags1_fields::ram_managed, r.ram_bytes.has_value() );
+
+         if( !r.net_weight || !r.cpu_weight ) {
+            user_resources_table userres( _self, r.account.value );
+            auto ritr = userres.find( r.account.value );
+
+            if( !r.net_weight ) {
+               eosio_assert( has_voter && has_field( flags, voter_info::flags1_fields::net_managed ),
+                             "Network bandwidth of account is already unmanaged" );
+               if( ritr != userres.end() ) {
+                  net = ritr->net_weight.amount;
+               }
+            }
+            if( !r.cpu_weight ) {
+               eosio_assert( has_voter && has_field( flags, voter_info::flags1_fields::cpu_managed ),
+                             "CPU bandwidth of account is already unmanaged" );
+               if( ritr != userres.end() ) {
+                  cpu = ritr->cpu_weight.amount;
+               }
+            }
+         }
+         if( r.net_weight ) {
+            eosio_assert( *r.net_weight >= -1, "invalid value for net_weight" );
+            net = *r.net_weight;
+         }
+         if( r.cpu_weight ) {
+            eosio_assert( *r.cpu_weight >= -1, "invalid value for cpu_weight" );
+            cpu = *r.cpu_weight;
+         }
+         flags = set_field( flags, voter_info::flags1_fields::net_managed, r.net_weight.has_value() );
+         flags = set_field( flags, voter_info::flags1_fields::cpu_managed, r.cpu_weight.has_value() );
+
+         if( !has_voter ) {
+            _voters.emplace( r.account, [&]( auto& v ) {
+               v.owner  = r.account;
+               v.flags1 = flags;
+            });
+         } else if( flags != old_flags ) {
+            _voters.modify( vitr, same_payer, [&]( auto& v ) {
+               v.flags1 = flags;
+            });
+         }
+
+         // eosio.token only needs to be told when the flag actually changes
+         const bool was_ram_managed = !has_voter || has_field( old_flags, voter_info::flags1_fields::ram_managed );
+         if( was_ram_managed != r.ram_bytes.has_value() ) {
+            INLINE_ACTION_SENDER(eosio::token, setrammanage)(
+               token_account, { {_self, active_permission} },
+               { r.account, r.ram_bytes.has_value() }
+            );
+         }
+
+         set_resource_limits( r.account.value, ram, net, cpu );
+      }
+   }
+
+   void system_contract::mirrorram( const std::vector<name>& accounts ) {
+      require_auth( _self );
+
+      for( const auto& account : accounts ) {
+         auto vitr = _voters.find( account.value );
+         bool managed = vitr == _voters.end() || has_field( vitr->flags1, voter_info::flags1_fields::ram_managed );
+         INLINE_ACTION_SENDER(eosio::token, setrammanage)(
+            token_account, { {_self, active_permission} },
+            { account, managed }
+         );
+      }
+   }
+
+   void system_contract::newaccounts( name creator, const std::vector<sidechain_account>& accounts ) {
+      require_auth( creator );
+      eosio_assert( creator == "eosio"_n || creator == "finexsidegtw"_n, "Not authorized to create a sidechain account" );
+      eosio_assert( accounts.size() > 0, "no accounts specified" );
+
+      std::vector<account_resources> resources;
+      resources.reserve( accounts.size() );
+
+      for( const auto& a : accounts ) {
+         eosio::action( permission_level{ creator, active_permission }, _self, "newaccount"_n,
+                        std::make_tuple( creator, a.account, a.owner, a.active ) ).send();
+
+         resources.push_back( { a.account, a.ram_bytes, a.net_weight, a.cpu_weight } );
+      }
+
+      // runs after all newaccount actions, the limits of the new accounts are checked at the end of the transaction
+      INLINE_ACTION_SENDER(system_contract, setacctres)(
+         _self, { {_self, active_permission} },
+         { resources }
+      );
+   }
+
    void system_contract::rmvproducer( name producer ) {
       require_auth( _self );
       auto prod = _producers.find( producer.value );
@@ -280,11 +455,11 @@ namespace eosiosystem {
 
    void system_contract::updtrevision( uint8_t revision ) {
       require_auth( _self );
-      eosio_assert( _gstate2.revision < 255, "can not increment revision" ); // prevent wrap around
-      eosio_assert( revision == _gstate2.revision + 1, "can only increment revision by one" );
+      eosio_assert( gstate2().revision < 255, "can not increment revision" ); // prevent wrap around
+      eosio_assert( revision == gstate2().revision + 1, "can only increment revision by one" );
       eosio_assert( revision <= 1, // set upper bound to greatest revision supported in the code
                     "specified revision is not yet supported by the code" );
-      _gstate2.revision = revision;
+      gstate2().revision = revision;
    }
 
    void system_contract::bidname( name bidder, name newname, asset bid ) {
@@ -403,14 +578,7 @@ namespace eosiosystem {
          }
       }*/
 
-      user_resources_table  userres( _self, newact.value);
-
-      userres.emplace( newact, [&]( auto& res ) {
-        res.owner = newact;
-        res.net_weight = asset( 0, system_contract::get_core_symbol() );
-        res.cpu_weight = asset( 0, system_contract::get_core_symbol() );
-      });
-
+      // the userres row is created by the first delegatebw or buyram, a missing row means nothing is staked
       set_resource_limits( newact.value, 0, 0, 0 );
    }
 
@@ -443,7 +611,7 @@ namespace eosiosystem {
       _rammarket.emplace( _self, [&]( auto& m ) {
          m.supply.amount = 100000000000000ll;
          m.supply.symbol = ramcore_symbol;
-         m.base.balance.amount = int64_t(_gstate.free_ram());
+         m.base.balance.amount = int64_t(gstate().free_ram());
          m.base.balance.symbol = ram_symbol;
          m.quote.balance.amount = system_token_supply.amount / 1000;
          m.quote.balance.symbol = core;
@@ -456,10 +624,10 @@ EOSIO_DISPATCH( eosiosystem::system_contract,
      // native.hpp (newaccount definition is actually in eosio.system.cpp)
      (newaccount)(updateauth)(deleteauth)(linkauth)(unlinkauth)(canceldelay)(onerror)(setabi)
      // eosio.system.cpp
-     (init)(setram)(setramrate)(setparams)(setpriv)(setalimits)(setacctram)(setacctnet)(setacctcpu)
+     (init)(setram)(setramrate)(setrefdelay)(setparams)(setpriv)(setalimits)(setacctram)(setacctnet)(setacctcpu)(setacctres)(newaccounts)(mirrorram)
      (rmvproducer)(updtrevision)(bidname)(bidrefund)
      // delegate_bandwidth.cpp
-     (buyrambytes)(buyram)(sellram)(delegatebw)(undelegatebw)(refund)
+     (buyrambytes)(buyram)(sellram)(quoteram)(delegatebw)(undelegatebw)(refund)
      // voting.cpp
      (regproducer)(unregprod)(voteproducer)(regproxy)
      // producer_pay.cpp
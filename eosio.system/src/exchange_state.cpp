@@ -2,15 +2,7 @@
 
 namespace eosiosystem {
    asset exchange_state::convert_to_exchange( connector& c, asset in ) {
-
-      real_type R(supply.amount);
-      real_type C(c.balance.amount+in.amount);
-      real_type F(c.weight);
-      real_type T(in.amount);
-      real_type ONE(1.0);
-
-      real_type E = -R * (ONE - std::pow( ONE + T / C, F) );
-      int64_t issued = int64_t(E);
+      int64_t issued = bancor_to_exchange<real_type>( supply.amount, c.balance.amount, in.amount, c.weight );
 
       supply.amount += issued;
       c.balance.amount += in.amount;
@@ -21,21 +13,7 @@ namespace eosiosystem {
    asset exchange_state::convert_from_exchange( connector& c, asset in ) {
       eosio_assert( in.symbol== supply.symbol, "unexpected asset symbol input" );
 
-      real_type R(supply.amount - in.amount);
-      real_type C(c.balance.amount);
-      real_type F(1.0/c.weight);
-      real_type E(in.amount);
-      real_type ONE(1.0);
-
-
-     // potentially more accurate: 
-     // The functions std::expm1 and std::log1p are useful for financial calculations, for example, 
-     // when calculating small daily interest rates: (1+x)n
-     // -1 can be expressed as std::expm1(n * std::log1p(x)). 
-     // real_type T = C * std::expm1( F * std::log1p(E/R) );
-      
-      real_type T = C * (std::pow( ONE + E/R, F) - ONE);
-      int64_t out = int64_t(T);
+      int64_t out = bancor_from_exchange<real_type>( supply.amount, c.balance.amount, in.amount, c.weight );
 
       supply.amount -= in.amount;
       c.balance.amount -= out;
@@ -78,6 +56,24 @@ namespace eosiosystem {
       return from;
    }
 
+   asset exchange_state::quote_buy( const asset& in )const {
+      eosio_assert( in.symbol == quote.balance.symbol, "unexpected asset symbol input" );
+
+      int64_t issued = bancor_to_exchange<real_type>( supply.amount, quote.balance.amount, in.amount, quote.weight );
+      int64_t out    = bancor_from_exchange<real_type>( supply.amount + issued, base.balance.amount, issued, base.weight );
+
+      return asset( out, base.balance.symbol );
+   }
+
+   asset exchange_state::quote_sell( const asset& in )const {
+      eosio_assert( in.symbol == base.balance.symbol, "unexpected asset symbol input" );
+
+      int64_t issued = bancor_to_exchange<real_type>( supply.amount, base.balance.amount, in.amount, base.weight );
+      int64_t out    = bancor_from_exchange<real_type>( supply.amount + issued, quote.balance.amount, issued, quote.weight );
+
+      return asset( out, quote.balance.symbol );
+   }
+
 
 
 } /// namespace eosiosystem
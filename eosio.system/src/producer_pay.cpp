@@ -25,46 +25,52 @@ namespace eosiosystem {
       name producer;
       _ds >> timestamp >> producer;
 
-      // _gstate2.last_block_num is not used anywhere in the system contract code anymore.
+      // gstate2().last_block_num is not used anywhere in the system contract code anymore.
       // Although this field is deprecated, we will continue updating it for now until the last_block_num field
       // is eventually completely removed, at which point this line can be removed.
-      _gstate2.last_block_num = timestamp;
+      gstate2().last_block_num = timestamp;
 
       /** until activated stake crosses this threshold no new rewards are paid */
-      if( _gstate.total_activated_stake < min_activated_stake )
+      if( gstate().total_activated_stake < min_activated_stake )
          return;
 
-      if( _gstate.last_pervote_bucket_fill == time_point() )  /// start the presses
-         _gstate.last_pervote_bucket_fill = current_time_point();
+      if( gstate().last_pervote_bucket_fill == time_point() )  /// start the presses
+         gstate().last_pervote_bucket_fill = current_time_point();
 
 
       /**
        * At startup the initial producer may not be one that is registered / elected
        * and therefore there may be no producer object for them.
+       * The block is counted in the producer's unpaidblocks row and folded into the producer row later.
        */
-      auto prod = _producers.find( producer.value );
-      if ( prod != _producers.end() ) {
-         _gstate.total_unpaid_blocks++;
-         _producers.modify( prod, same_payer, [&](auto& p ) {
-               p.unpaid_blocks++;
+      unpaid_blocks_table counters( _self, _self.value );
+      auto count = counters.find( producer.value );
+      if( count != counters.end() ) {
+         counters.modify( count, same_payer, [&]( auto& c ) {
+            ++c.blocks;
+         });
+      } else if( _producers.find( producer.value ) != _producers.end() ) {
+         counters.emplace( _self, [&]( auto& c ) {
+            c.producer = producer;
+            c.blocks   = 1;
          });
       }
 
       /// only update block producers once every minute, block_timestamp is in half seconds
-      if( timestamp.slot - _gstate.last_producer_schedule_update.slot > 120 ) {
+      if( timestamp.slot - gstate().last_producer_schedule_update.slot > 120 ) {
          update_elected_producers( timestamp );
 
-         if( (timestamp.slot - _gstate.last_name_close.slot) > blocks_per_day ) {
+         if( (timestamp.slot - gstate().last_name_close.slot) > blocks_per_day ) {
             name_bid_table bids(_self, _self.value);
             auto idx = bids.get_index<"highbid"_n>();
             auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
             if( highest != idx.end() &&
                 highest->high_bid > 0 &&
                 (current_time_point() - highest->last_bid_time) > microseconds(useconds_per_day) &&
-                _gstate.thresh_activated_stake_time > time_point() &&
-                (current_time_point() - _gstate.thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
+                gstate().thresh_activated_stake_time > time_point() &&
+                (current_time_point() - gstate().thresh_activated_stake_time) > microseconds(14 * useconds_per_day)
             ) {
-               _gstate.last_name_close = timestamp;
+               gstate().last_name_close = timestamp;
                idx.modify( highest, same_payer, [&]( auto& b ){
                   b.high_bid = -b.high_bid;
                });
@@ -73,14 +79,29 @@ namespace eosiosystem {
       }
    }
 
+   void system_contract::fold_unpaid_blocks() {
+      unpaid_blocks_table counters( _self, _self.value );
+      for( auto c = counters.begin(); c != counters.end(); c = counters.erase( c ) ) {
+         auto prod = _producers.find( c->producer.value );
+         if( prod != _producers.end() ) {
+            gstate().total_unpaid_blocks += c->blocks;
+            _producers.modify( prod, same_payer, [&](auto& p ) {
+                  p.unpaid_blocks += c->blocks;
+            });
+         }
+      }
+   }
+
    using namespace eosio;
    void system_contract::claimrewards( const name owner ) {
       require_auth( owner );
 
+      fold_unpaid_blocks();
+
       const auto& prod = _producers.get( owner.value );
       eosio_assert( prod.active(), "producer does not have an active key" );
 
-      eosio_assert( _gstate.total_activated_stake >= min_activated_stake,
+      eosio_assert( gstate().total_activated_stake >= min_activated_stake,
                     "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)" );
 
       const auto ct = current_time_point();
@@ -88,9 +109,9 @@ namespace eosiosystem {
       eosio_assert( ct - prod.last_claim_time > microseconds(useconds_per_day), "already claimed rewards within past day" );
 
       const asset token_supply   = eosio::token::get_supply(token_account, core_symbol().code() );
-      const auto usecs_since_last_fill = (ct - _gstate.last_pervote_bucket_fill).count();
+      const auto usecs_since_last_fill = (ct - gstate().last_pervote_bucket_fill).count();
 
-      if( usecs_since_last_fill > 0 && _gstate.last_pervote_bucket_fill > time_point() ) {
+      if( usecs_since_last_fill > 0 && gstate().last_pervote_bucket_fill > time_point() ) {
          auto new_tokens = static_cast<int64_t>( (continuous_rate * double(token_supply.amount) * double(usecs_since_last_fill)) / double(useconds_per_year) );
 
          auto to_producers     = new_tokens / 5;
@@ -98,29 +119,24 @@ namespace eosiosystem {
          auto to_per_block_pay = to_producers / 4;
          auto to_per_vote_pay  = to_producers - to_per_block_pay;
 
-         INLINE_ACTION_SENDER(eosio::token, issue)(
-            token_account, { {_self, active_permission} },
-            { _self, asset(new_tokens, core_symbol()), std::string("issue tokens for producer pay and savings") }
-         );
-
-         INLINE_ACTION_SENDER(eosio::token, transfer)(
-            token_account, { {_self, active_permission} },
-            { _self, saving_account, asset(to_savings, core_symbol()), "unallocated inflation" }
-         );
-
-         INLINE_ACTION_SENDER(eosio::token, transfer)(
-            token_account, { {_self, active_permission} },
-            { _self, bpay_account, asset(to_per_block_pay, core_symbol()), "fund per-block bucket" }
-         );
-
-         INLINE_ACTION_SENDER(eosio::token, transfer)(
-            token_account, { {_self, active_permission} },
-            { _self, vpay_account, asset(to_per_vote_pay, core_symbol()), "fund per-vote bucket" }
-         );
+         // minted and credited to the buckets by one action, instead of an issue and three transfers
+         std::vector<eosio::issue_item> issues;
+         for( const auto& split : { std::make_pair( saving_account, to_savings ),
+                                    std::make_pair( bpay_account,   to_per_block_pay ),
+                                    std::make_pair( vpay_account,   to_per_vote_pay ) } ) {
+            if( split.second > 0 )
+               issues.push_back( { split.first, asset(split.second, core_symbol()) } );
+         }
+         if( !issues.empty() ) {
+            INLINE_ACTION_SENDER(eosio::token, issuemany)(
+               token_account, { {_self, active_permission} },
+               { issues, std::string("issue tokens for producer pay and savings") }
+            );
+         }
 
-         _gstate.pervote_bucket          += to_per_vote_pay;
-         _gstate.perblock_bucket         += to_per_block_pay;
-         _gstate.last_pervote_bucket_fill = ct;
+         gstate().pervote_bucket          += to_per_vote_pay;
+         gstate().perblock_bucket         += to_per_block_pay;
+         gstate().last_pervote_bucket_fill = ct;
       }
 
       auto prod2 = _producers2.find( owner.value );
@@ -146,8 +162,8 @@ namespace eosiosystem {
       // In fact it is desired behavior because the producers votes need to be counted in the global total_producer_votepay_share for the first time.
 
       int64_t producer_per_block_pay = 0;
-      if( _gstate.total_unpaid_blocks > 0 ) {
-         producer_per_block_pay = (_gstate.perblock_bucket * prod.unpaid_blocks) / _gstate.total_unpaid_blocks;
+      if( gstate().total_unpaid_blocks > 0 ) {
+         producer_per_block_pay = (gstate().perblock_bucket * prod.unpaid_blocks) / gstate().total_unpaid_blocks;
       }
 
       double new_votepay_share = update_producer_votepay_share( prod2,
@@ -157,16 +173,16 @@ namespace eosiosystem {
                                  );
 
       int64_t producer_per_vote_pay = 0;
-      if( _gstate2.revision > 0 ) {
+      if( gstate2().revision > 0 ) {
          double total_votepay_share = update_total_votepay_share( ct );
          if( total_votepay_share > 0 && !crossed_threshold ) {
-            producer_per_vote_pay = int64_t((new_votepay_share * _gstate.pervote_bucket) / total_votepay_share);
-            if( producer_per_vote_pay > _gstate.pervote_bucket )
-               producer_per_vote_pay = _gstate.pervote_bucket;
+            producer_per_vote_pay = int64_t((new_votepay_share * gstate().pervote_bucket) / total_votepay_share);
+            if( producer_per_vote_pay > gstate().pervote_bucket )
+               producer_per_vote_pay = gstate().pervote_bucket;
          }
       } else {
-         if( _gstate.total_producer_vote_weight > 0 ) {
-            producer_per_vote_pay = int64_t((_gstate.pervote_bucket * prod.total_votes) / _gstate.total_producer_vote_weight);
+         if( gstate().total_producer_vote_weight > 0 ) {
+            producer_per_vote_pay = int64_t((gstate().pervote_bucket * prod.total_votes) / gstate().total_producer_vote_weight);
          }
       }
 
@@ -174,9 +190,9 @@ namespace eosiosystem {
          producer_per_vote_pay = 0;
       }
 
-      _gstate.pervote_bucket      -= producer_per_vote_pay;
-      _gstate.perblock_bucket     -= producer_per_block_pay;
-      _gstate.total_unpaid_blocks -= prod.unpaid_blocks;
+      gstate().pervote_bucket      -= producer_per_vote_pay;
+      gstate().perblock_bucket     -= producer_per_block_pay;
+      gstate().total_unpaid_blocks -= prod.unpaid_blocks;
 
       update_total_votepay_share( ct, -new_votepay_share, (updated_after_threshold ? prod.total_votes : 0.0) );
 
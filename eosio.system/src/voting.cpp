@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 
 namespace eosiosystem {
    using eosio::indexed_by;
@@ -88,7 +89,8 @@ namespace eosiosystem {
    }
 
    void system_contract::update_elected_producers( block_timestamp block_time ) {
-      _gstate.last_producer_schedule_update = block_time;
+      gstate().last_producer_schedule_update = block_time;
+      fold_unpaid_blocks();
 
       auto idx = _producers.get_index<"prototalvote"_n>();
 
@@ -99,7 +101,7 @@ namespace eosiosystem {
          top_producers.emplace_back( std::pair<eosio::producer_key,uint16_t>({{it->owner, it->producer_key}, it->location}) );
       }
 
-      if ( top_producers.size() < _gstate.last_producer_schedule_size ) {
+      if ( top_producers.size() < gstate().last_producer_schedule_size ) {
          return;
       }
 
@@ -114,15 +116,34 @@ namespace eosiosystem {
 
       auto packed_schedule = pack(producers);
 
+      /// the elected schedule rarely changes, only propose it again when it differs from the last one proposed
+      capi_checksum256 schedule_hash;
+      sha256( packed_schedule.data(), packed_schedule.size(), &schedule_hash );
+      auto& last_hash = gstate3().last_proposed_schedule_hash;
+      if( last_hash.has_value() && std::memcmp( last_hash->hash, schedule_hash.hash, sizeof(schedule_hash.hash) ) == 0 ) {
+         return;
+      }
+
       if( set_proposed_producers( packed_schedule.data(),  packed_schedule.size() ) >= 0 ) {
-         _gstate.last_producer_schedule_size = static_cast<decltype(_gstate.last_producer_schedule_size)>( top_producers.size() );
+         gstate().last_producer_schedule_size = static_cast<decltype(gstate().last_producer_schedule_size)>( top_producers.size() );
+         last_hash.emplace( schedule_hash );
       }
    }
 
-   double stake2vote( int64_t staked ) {
+   double system_contract::stake2vote( int64_t staked ) {
       /// TODO subtract 2080 brings the large numbers closer to this decade
-      double weight = int64_t( (now() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) )  / double( 52 );
-      return double(staked) * std::pow( 2, weight );
+      const int64_t week = int64_t( (now() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) );
+      if( !_vote_decay || _vote_decay->week != week ) {
+         vote_decay_singleton decay( _self, _self.value );
+         _vote_decay = decay.get_or_default();
+         if( _vote_decay->week != week ) {
+            double weight = week / double( 52 );
+            _vote_decay->week       = static_cast<uint32_t>( week );
+            _vote_decay->multiplier = std::pow( 2, weight );
+            decay.set( *_vote_decay, _self );
+         }
+      }
+      return double(staked) * _vote_decay->multiplier;
    }
 
    double system_contract::update_total_votepay_share( time_point ct,
@@ -130,27 +151,27 @@ namespace eosiosystem {
                                                        double shares_rate_delta )
    {
       double delta_total_votepay_share = 0.0;
-      if( ct > _gstate3.last_vpay_state_update ) {
-         delta_total_votepay_share = _gstate3.total_vpay_share_change_rate
-                                       * double( (ct - _gstate3.last_vpay_state_update).count() / 1E6 );
+      if( ct > gstate3().last_vpay_state_update ) {
+         delta_total_votepay_share = gstate3().total_vpay_share_change_rate
+                                       * double( (ct - gstate3().last_vpay_state_update).count() / 1E6 );
       }
 
       delta_total_votepay_share += additional_shares_delta;
-      if( delta_total_votepay_share < 0 && _gstate2.total_producer_votepay_share < -delta_total_votepay_share ) {
-         _gstate2.total_producer_votepay_share = 0.0;
+      if( delta_total_votepay_share < 0 && gstate2().total_producer_votepay_share < -delta_total_votepay_share ) {
+         gstate2().total_producer_votepay_share = 0.0;
       } else {
-         _gstate2.total_producer_votepay_share += delta_total_votepay_share;
+         gstate2().total_producer_votepay_share += delta_total_votepay_share;
       }
 
-      if( shares_rate_delta < 0 && _gstate3.total_vpay_share_change_rate < -shares_rate_delta ) {
-         _gstate3.total_vpay_share_change_rate = 0.0;
+      if( shares_rate_delta < 0 && gstate3().total_vpay_share_change_rate < -shares_rate_delta ) {
+         gstate3().total_vpay_share_change_rate = 0.0;
       } else {
-         _gstate3.total_vpay_share_change_rate += shares_rate_delta;
+         gstate3().total_vpay_share_change_rate += shares_rate_delta;
       }
 
-      _gstate3.last_vpay_state_update = ct;
+      gstate3().last_vpay_state_update = ct;
 
-      return _gstate2.total_producer_votepay_share;
+      return gstate2().total_producer_votepay_share;
    }
 
    double system_contract::update_producer_votepay_share( const producers_table2::const_iterator& prod_itr,
@@ -193,7 +214,9 @@ namespace eosiosystem {
     *  If voting for a proxy, the producer votes will not change until the proxy updates their own vote.
     */
    void system_contract::voteproducer( const name voter_name, const name proxy, const std::vector<name>& producers ) {
+#ifndef EOSIO_SYSTEM_ENABLE_VOTING
       eosio_assert( false, "Chain does not support voting for producers" );
+#endif
       require_auth( voter_name );
       update_votes( voter_name, proxy, producers, true );
    }
@@ -220,9 +243,9 @@ namespace eosiosystem {
        * their first vote and should consider their stake activated.
        */
       if( voter->last_vote_weight <= 0.0 ) {
-         _gstate.total_activated_stake += voter->staked;
-         if( _gstate.total_activated_stake >= min_activated_stake && _gstate.thresh_activated_stake_time == time_point() ) {
-            _gstate.thresh_activated_stake_time = current_time_point();
+         gstate().total_activated_stake += voter->staked;
+         if( gstate().total_activated_stake >= min_activated_stake && gstate().thresh_activated_stake_time == time_point() ) {
+            gstate().thresh_activated_stake_time = current_time_point();
          }
       }
 
@@ -231,7 +254,8 @@ namespace eosiosystem {
          new_vote_weight += voter->proxied_vote_weight;
       }
 
-      boost::container::flat_map<name, pair<double, bool /*new*/> > producer_deltas;
+      producer_vote_deltas producer_deltas;
+      double old_vote_weight = 0;
       if ( voter->last_vote_weight > 0 ) {
          if( voter->proxy ) {
             auto old_proxy = _voters.find( voter->proxy.value );
@@ -239,12 +263,14 @@ namespace eosiosystem {
             _voters.modify( old_proxy, same_payer, [&]( auto& vp ) {
                   vp.proxied_vote_weight -= voter->last_vote_weight;
                });
-            propagate_weight_change( *old_proxy );
+            propagate_weight_change( *old_proxy, producer_deltas );
          } else {
+            old_vote_weight = voter->last_vote_weight;
+            /// votes stored as names, by a build without EOSIO_SYSTEM_PRODUCER_BITS or before it was used
             for( const auto& p : voter->producers ) {
                auto& d = producer_deltas[p];
-               d.first -= voter->last_vote_weight;
-               d.second = false;
+               d.votes -= old_vote_weight;
+               d.voted  = true;
             }
          }
       }
@@ -257,68 +283,120 @@ namespace eosiosystem {
             _voters.modify( new_proxy, same_payer, [&]( auto& vp ) {
                   vp.proxied_vote_weight += new_vote_weight;
                });
-            propagate_weight_change( *new_proxy );
+            propagate_weight_change( *new_proxy, producer_deltas );
          }
-      } else {
-         if( new_vote_weight >= 0 ) {
-            for( const auto& p : producers ) {
-               auto& d = producer_deltas[p];
-               d.first += new_vote_weight;
-               d.second = true;
+      }
+
+      /// votes stored as bits, also read by builds without EOSIO_SYSTEM_PRODUCER_BITS so that they drop them
+      std::vector<uint64_t> old_bits;
+      if( voter->producer_bits.has_value() ) {
+         old_bits = voter->producer_bits.value();
+      }
+      std::vector<uint64_t> new_bits;
+
+      const bool count_new = new_vote_weight >= 0;
+      for( const auto& p : producers ) {
+         bool kept = false;
+#ifdef EOSIO_SYSTEM_PRODUCER_BITS
+         const uint64_t slot = producer_slot_of( p );
+         const uint64_t bit  = uint64_t(1) << (slot % 64);
+         if( new_bits.size() <= slot / 64 )
+            new_bits.resize( slot / 64 + 1 );
+         new_bits[slot / 64] |= bit;
+         kept = slot / 64 < old_bits.size() && (old_bits[slot / 64] & bit);
+         if( !kept )
+            update_slot_voters( _producer_slots.get( slot, "producer slot not found" ), 1 );
+#endif
+         if( count_new || ( kept && old_vote_weight > 0 ) ) {
+            auto& d = producer_deltas[p];
+            if( kept ) d.votes -= old_vote_weight;
+            if( count_new ) {
+               d.votes += new_vote_weight;
+               d.from_new_set = true;
             }
+            d.voted = true;
          }
       }
 
-      const auto ct = current_time_point();
-      double delta_change_rate         = 0.0;
-      double total_inactive_vpay_share = 0.0;
-      for( const auto& pd : producer_deltas ) {
-         auto pitr = _producers.find( pd.first.value );
-         if( pitr != _producers.end() ) {
-            eosio_assert( !voting || pitr->active() || !pd.second.second /* not from new set */, "producer is not currently registered" );
-            double init_total_votes = pitr->total_votes;
-            _producers.modify( pitr, same_payer, [&]( auto& p ) {
-               p.total_votes += pd.second.first;
-               if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
-                  p.total_votes = 0;
-               }
-               _gstate.total_producer_vote_weight += pd.second.first;
-               //eosio_assert( p.total_votes >= 0, "something bad happened" );
-            });
-            auto prod2 = _producers2.find( pd.first.value );
-            if( prod2 != _producers2.end() ) {
-               const auto last_claim_plus_3days = pitr->last_claim_time + microseconds(3 * useconds_per_day);
-               bool crossed_threshold       = (last_claim_plus_3days <= ct);
-               bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
-               // Note: updated_after_threshold implies cross_threshold
-
-               double new_votepay_share = update_producer_votepay_share( prod2,
-                                             ct,
-                                             updated_after_threshold ? 0.0 : init_total_votes,
-                                             crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
-                                          );
-
-               if( !crossed_threshold ) {
-                  delta_change_rate += pd.second.first;
-               } else if( !updated_after_threshold ) {
-                  total_inactive_vpay_share += new_votepay_share;
-                  delta_change_rate -= init_total_votes;
-               }
+      /// producers dropped from the bitset are the only slots read by name, kept ones were handled above
+      for( size_t w = 0; w < old_bits.size(); ++w ) {
+         const uint64_t n = w < new_bits.size() ? new_bits[w] : 0;
+         for( uint64_t removed = old_bits[w] & ~n; removed; removed &= removed - 1 ) {
+            const auto& s = _producer_slots.get( w * 64 + __builtin_ctzll( removed ), "producer slot not found" );
+            if( old_vote_weight > 0 ) {
+               auto& d = producer_deltas[s.owner];
+               d.votes -= old_vote_weight;
+               d.voted  = true;
             }
-         } else {
-            eosio_assert( !pd.second.second /* not from new set */, "producer is not registered" ); //data corruption
+            update_slot_voters( s, -1 );
          }
       }
 
-      update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
+      apply_producer_deltas( producer_deltas, voting );
 
       _voters.modify( voter, same_payer, [&]( auto& av ) {
          av.last_vote_weight = new_vote_weight;
+#ifdef EOSIO_SYSTEM_PRODUCER_BITS
+         av.producers.clear();
+         av.producer_bits.emplace( std::move(new_bits) );
+#else
          av.producers = producers;
+         if( av.producer_bits.has_value() )
+            av.producer_bits.emplace();
+#endif
          av.proxy     = proxy;
       });
    }
 
+   uint64_t system_contract::producer_slot_of( name producer ) {
+      auto idx = _producer_slots.get_index<"byowner"_n>();
+      auto itr = idx.find( producer.value );
+      if( itr != idx.end() )
+         return itr->slot;
+
+      auto free_slot = idx.find( name().value );
+      if( free_slot != idx.end() ) {
+         const uint64_t slot = free_slot->slot;
+         idx.modify( free_slot, same_payer, [&]( auto& s ) {
+            s.owner = producer;
+         });
+         return slot;
+      }
+
+      const uint64_t slot = _producer_slots.available_primary_key();
+      _producer_slots.emplace( _self, [&]( auto& s ) {
+         s.slot  = slot;
+         s.owner = producer;
+      });
+      return slot;
+   }
+
+   /// frees the slot once no voter bitset refers to it any more
+   void system_contract::update_slot_voters( const producer_slot& s, int64_t delta ) {
+      eosio_assert( delta >= 0 || s.voters >= uint64_t(-delta), "producer slot voters out of sync" ); // should never happen
+      _producer_slots.modify( s, same_payer, [&]( auto& ps ) {
+         ps.voters += delta;
+         if( ps.voters == 0 )
+            ps.owner = name();
+      });
+   }
+
+   /// the producers `voter` votes for, sorted by name
+   std::vector<name> system_contract::voted_producers( const voter_info& voter ) {
+      if( !voter.producer_bits.has_value() || voter.producer_bits.value().empty() )
+         return voter.producers;
+
+      std::vector<name> producers;
+      const auto& bits = voter.producer_bits.value();
+      for( size_t w = 0; w < bits.size(); ++w ) {
+         for( uint64_t b = bits[w]; b; b &= b - 1 ) {
+            producers.push_back( _producer_slots.get( w * 64 + __builtin_ctzll( b ), "producer slot not found" ).owner );
+         }
+      }
+      std::sort( producers.begin(), producers.end() );
+      return producers;
+   }
+
    /**
     *  An account marked as a proxy can vote with the weight of other accounts which
     *  have selected it as a proxy. Other accounts must refresh their voteproducer to
@@ -338,7 +416,9 @@ namespace eosiosystem {
          _voters.modify( pitr, same_payer, [&]( auto& p ) {
                p.is_proxy = isproxy;
             });
-         propagate_weight_change( *pitr );
+         producer_vote_deltas producer_deltas;
+         propagate_weight_change( *pitr, producer_deltas );
+         apply_producer_deltas( producer_deltas, false );
       } else {
          _voters.emplace( proxy, [&]( auto& p ) {
                p.owner  = proxy;
@@ -347,63 +427,92 @@ namespace eosiosystem {
       }
    }
 
-   void system_contract::propagate_weight_change( const voter_info& voter ) {
-      eosio_assert( !voter.proxy || !voter.is_proxy, "account registered as a proxy is not allowed to use a proxy" );
-      double new_weight = stake2vote( voter.staked );
-      if ( voter.is_proxy ) {
-         new_weight += voter.proxied_vote_weight;
-      }
+   /**
+    *  Updates the vote weight of `voter` and walks up its proxy, adding the resulting change of every
+    *  producer vote to `producer_deltas` instead of updating the producer rows right away. The caller
+    *  applies all of them once with apply_producer_deltas.
+    */
+   void system_contract::propagate_weight_change( const voter_info& voter, producer_vote_deltas& producer_deltas ) {
+      const voter_info* current = &voter;
+      while( current ) {
+         eosio_assert( !current->proxy || !current->is_proxy, "account registered as a proxy is not allowed to use a proxy" );
+         double new_weight = stake2vote( current->staked );
+         if ( current->is_proxy ) {
+            new_weight += current->proxied_vote_weight;
+         }
 
-      /// don't propagate small changes (1 ~= epsilon)
-      if ( fabs( new_weight - voter.last_vote_weight ) > 1 )  {
-         if ( voter.proxy ) {
-            auto& proxy = _voters.get( voter.proxy.value, "proxy not found" ); //data corruption
-            _voters.modify( proxy, same_payer, [&]( auto& p ) {
-                  p.proxied_vote_weight += new_weight - voter.last_vote_weight;
-               }
-            );
-            propagate_weight_change( proxy );
-         } else {
-            auto delta = new_weight - voter.last_vote_weight;
-            const auto ct = current_time_point();
-            double delta_change_rate         = 0;
-            double total_inactive_vpay_share = 0;
-            for ( auto acnt : voter.producers ) {
-               auto& prod = _producers.get( acnt.value, "producer not found" ); //data corruption
-               const double init_total_votes = prod.total_votes;
-               _producers.modify( prod, same_payer, [&]( auto& p ) {
-                  p.total_votes += delta;
-                  _gstate.total_producer_vote_weight += delta;
-               });
-               auto prod2 = _producers2.find( acnt.value );
-               if ( prod2 != _producers2.end() ) {
-                  const auto last_claim_plus_3days = prod.last_claim_time + microseconds(3 * useconds_per_day);
-                  bool crossed_threshold       = (last_claim_plus_3days <= ct);
-                  bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
-                  // Note: updated_after_threshold implies cross_threshold
-
-                  double new_votepay_share = update_producer_votepay_share( prod2,
-                                                ct,
-                                                updated_after_threshold ? 0.0 : init_total_votes,
-                                                crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
-                                             );
-
-                  if( !crossed_threshold ) {
-                     delta_change_rate += delta;
-                  } else if( !updated_after_threshold ) {
-                     total_inactive_vpay_share += new_votepay_share;
-                     delta_change_rate -= init_total_votes;
+         const voter_info* next = nullptr;
+         /// don't propagate small changes (1 ~= epsilon)
+         if ( fabs( new_weight - current->last_vote_weight ) > 1 )  {
+            if ( current->proxy ) {
+               auto& proxy = _voters.get( current->proxy.value, "proxy not found" ); //data corruption
+               _voters.modify( proxy, same_payer, [&]( auto& p ) {
+                     p.proxied_vote_weight += new_weight - current->last_vote_weight;
                   }
+               );
+               next = &proxy;
+            } else {
+               auto delta = new_weight - current->last_vote_weight;
+               for ( auto acnt : voted_producers( *current ) ) {
+                  auto& d = producer_deltas[acnt];
+                  d.votes  += delta;
+                  d.proxied = true;
                }
             }
-
-            update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
          }
+         _voters.modify( *current, same_payer, [&]( auto& v ) {
+               v.last_vote_weight = new_weight;
+            }
+         );
+         current = next;
       }
-      _voters.modify( voter, same_payer, [&]( auto& v ) {
-            v.last_vote_weight = new_weight;
+   }
+
+   void system_contract::apply_producer_deltas( const producer_vote_deltas& producer_deltas, bool voting ) {
+      const auto ct = current_time_point();
+      double delta_change_rate         = 0.0;
+      double total_inactive_vpay_share = 0.0;
+      for( const auto& pd : producer_deltas ) {
+         const auto& d = pd.second;
+         auto pitr = _producers.find( pd.first.value );
+         eosio_assert( pitr != _producers.end() || !d.proxied, "producer not found" ); //data corruption
+         if( pitr != _producers.end() ) {
+            eosio_assert( !voting || pitr->active() || !d.from_new_set, "producer is not currently registered" );
+            double init_total_votes = pitr->total_votes;
+            _producers.modify( pitr, same_payer, [&]( auto& p ) {
+               p.total_votes += d.votes;
+               if ( d.voted && p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
+                  p.total_votes = 0;
+               }
+               gstate().total_producer_vote_weight += d.votes;
+               //eosio_assert( p.total_votes >= 0, "something bad happened" );
+            });
+            auto prod2 = _producers2.find( pd.first.value );
+            if( prod2 != _producers2.end() ) {
+               const auto last_claim_plus_3days = pitr->last_claim_time + microseconds(3 * useconds_per_day);
+               bool crossed_threshold       = (last_claim_plus_3days <= ct);
+               bool updated_after_threshold = (last_claim_plus_3days <= prod2->last_votepay_share_update);
+               // Note: updated_after_threshold implies cross_threshold
+
+               double new_votepay_share = update_producer_votepay_share( prod2,
+                                             ct,
+                                             updated_after_threshold ? 0.0 : init_total_votes,
+                                             crossed_threshold && !updated_after_threshold // only reset votepay_share once after threshold
+                                          );
+
+               if( !crossed_threshold ) {
+                  delta_change_rate += d.votes;
+               } else if( !updated_after_threshold ) {
+                  total_inactive_vpay_share += new_votepay_share;
+                  delta_change_rate -= init_total_votes;
+               }
+            }
+         } else {
+            eosio_assert( !d.from_new_set, "producer is not registered" ); //data corruption
          }
-      );
+      }
+
+      update_total_votepay_share( ct, -total_inactive_vpay_share, delta_change_rate );
    }
 
 } /// namespace eosiosystem
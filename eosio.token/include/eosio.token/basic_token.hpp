@@ -0,0 +1,841 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosiolib/asset.hpp>
+#include <eosiolib/db.h>
+#include <eosiolib/eosio.hpp>
+
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace eosio {
+
+   using std::string;
+
+   struct transfer_item {
+      name     to;
+      asset    quantity;
+      string   memo;
+
+      EOSLIB_SERIALIZE( transfer_item, (to)(quantity)(memo) )
+   };
+
+   struct issue_item {
+      name     to;
+      asset    quantity;
+
+      EOSLIB_SERIALIZE( issue_item, (to)(quantity) )
+   };
+
+   /**
+    *  Compile-time features of basic_token. A token contract derives its policy from this
+    *  one and overrides the switches it needs; disabled features are removed from the WASM
+    *  by `if constexpr` instead of being checked at run time.
+    *
+    *  A policy enabling sync_ram_limits must also provide `ram_symbol` and
+    *  `static void on_ram_balance_change( name token_contract, name owner, const asset& old_balance, const asset& new_balance )`.
+    */
+   struct default_token_policy {
+      static constexpr bool    enforce_precision = false;  ///< reject create for any precision other than `precision`
+      static constexpr uint8_t precision         = 0;
+      static constexpr bool    sync_ram_limits   = false;  ///< call on_ram_balance_change for balances of ram_symbol
+      static constexpr bool    freezable         = true;   ///< frozen accounts cannot send, receive or close balances
+      static constexpr bool    pausable          = true;   ///< paused symbols cannot be transferred
+      static constexpr bool    compact_balances  = false;  ///< store balances as bare amounts in the `balances` table
+      static constexpr bool    checkpoints       = false;  ///< keep the balance history needed by balance_at
+      static constexpr bool    holder_index      = false;  ///< keep a holders table sorted by amount for opted-in symbols
+   };
+
+   /**
+    *  Token logic shared by eosio.token and tether.token.
+    *
+    *  `Contract` is the deployed contract class deriving from basic_token. It declares the
+    *  actions and the `accounts`, `stats`, `frozen_accounts` and `frozen_stats_singleton`
+    *  tables, so that the ABI generator sees them under its own contract name, and forwards
+    *  each action to the implementation of the same name here.
+    *
+    *  With compact_balances the issuer of a symbol can move it to the `balances` table with
+    *  the compactbal action. A row there holds only the int64 amount, keyed by the symbol code
+    *  in the owner's scope; the precision is taken from stats. This saves the 8 byte symbol
+    *  every `accounts` row repeats, but readers of `accounts`, such as get_currency_balance
+    *  of chain_plugin, no longer see the balances that were moved. Symbols are therefore
+    *  compacted only on request, and only new rows and rows of owners sending the symbol
+    *  are moved: sub_balance migrates a legacy row at the expense of its owner, while
+    *  add_balance updates it in place so that a sender never pays for the recipient's row.
+    *
+    *  With checkpoints the issuer of a symbol can take numbered snapshots of its balances with
+    *  the checkpoint action, which bumps the `epoch` kept in stats. The first change of a
+    *  balance after snapshot n stores the balance it replaces as (n, amount) in the
+    *  `checkpoints` table of the owner's scope, so the balance at snapshot n is the first
+    *  history row at or after n or, failing that, the current balance. Symbols that were
+    *  never checkpointed have epoch 0 and record nothing.
+    *
+    *  With holder_index the issuer can turn on a `holders` table for a symbol with the
+    *  trackholders action. It is scoped by the symbol code, has a row per owner with a
+    *  positive balance and a `byamount` index ordered by descending amount, so top holders
+    *  and holders above a threshold are an index range instead of a walk over every owner
+    *  scope. Balances that existed before tracking started are added with syncholder.
+    *  Both features keep their per-symbol switch in binary extensions of stats.
+    */
+   template<typename Contract, typename Policy>
+   class basic_token : public contract {
+      public:
+         basic_token( name receiver, name code, datastream<const char*> ds ) : contract(receiver, code, ds) { }
+
+         /**
+          *  Read-only accessors for other contracts. They find the row with db_find_i64 and copy
+          *  only its leading asset (or amount) instead of deserializing it through multi_index.
+          */
+         static asset get_supply( name token_contract_account, symbol_code sym_code )
+         {
+            return read_leading_asset( token_contract_account, sym_code.raw(), stats_table, sym_code.raw() );
+         }
+
+         static asset get_balance( name token_contract_account, name owner, symbol_code sym_code )
+         {
+            if constexpr( Policy::compact_balances ) {
+               auto itr = find_compact_balance( token_contract_account, owner, sym_code );
+               if( itr >= 0 ) {
+                  return asset( read_compact_balance( itr ), get_supply( token_contract_account, sym_code ).symbol );
+               }
+            }
+            return read_leading_asset( token_contract_account, owner.value, accounts_table, sym_code.raw() );
+         }
+
+         /**
+          *  Balances of `owner` for each of `sym_codes`, in the same order. A missing balance row
+          *  reads as zero; a symbol without stats fails the transaction.
+          */
+         static std::vector<asset> get_balances( name token_contract_account, name owner, const std::vector<symbol_code>& sym_codes )
+         {
+            std::vector<asset> balances;
+            balances.reserve( sym_codes.size() );
+            for( const auto& sym_code : sym_codes ) {
+               if constexpr( Policy::compact_balances ) {
+                  auto itr = find_compact_balance( token_contract_account, owner, sym_code );
+                  if( itr >= 0 ) {
+                     balances.emplace_back( read_compact_balance( itr ), get_supply( token_contract_account, sym_code ).symbol );
+                     continue;
+                  }
+               }
+               auto itr = db_find_i64( token_contract_account.value, owner.value, accounts_table.value, sym_code.raw() );
+               if( itr >= 0 ) {
+                  balances.push_back( read_leading_asset( itr ) );
+               } else {
+                  balances.emplace_back( 0, get_supply( token_contract_account, sym_code ).symbol );
+               }
+            }
+            return balances;
+         }
+
+         /**
+          *  Balance of `owner` when snapshot `epoch` of `sym_code` was taken, found with a
+          *  lower_bound on the owner's checkpoint history.
+          */
+         static asset balance_at( name token_contract_account, name owner, symbol_code sym_code, uint64_t epoch )
+         {
+            static_assert( Policy::checkpoints, "token policy does not keep checkpoints" );
+
+            typename Contract::stats statstable( token_contract_account, sym_code.raw() );
+            const auto& st = statstable.get( sym_code.raw(), "symbol does not exist" );
+            eosio_assert( epoch > 0 && epoch <= st.epoch.value_or(0), "checkpoint does not exist" );
+
+            typename Contract::balance_checkpoints history( token_contract_account, owner.value );
+            auto idx = history.template get_index<"byepoch"_n>();
+            auto it = idx.lower_bound( Contract::balance_checkpoint::epoch_key( sym_code, epoch ) );
+            if( it != idx.end() && it->sym == sym_code ) {
+               return asset( it->amount, st.supply.symbol );
+            }
+            return get_balances( token_contract_account, owner, { sym_code } ).front();
+         }
+
+      protected:
+         void create( name issuer, asset maximum_supply );
+         void issue( name to, asset quantity, const string& memo );
+         void issuemany( const std::vector<issue_item>& issues, const string& memo );
+         void retire( asset quantity, const string& memo );
+         void transfer( name from, name to, asset quantity, const string& memo );
+         void transferbatch( name from, const std::vector<transfer_item>& transfers );
+         void open( name owner, const symbol& symbol, name ram_payer );
+         void close( name owner, const symbol& symbol );
+         void freeze( name account );
+         void unfreeze( name account );
+         void pause( const symbol_code& sym );
+         void unpause( const symbol_code& sym );
+         void checkpoint( const symbol_code& sym );
+         void trackholders( const symbol_code& sym, bool track );
+         void syncholder( name owner, const symbol_code& sym );
+         void compactbal( const symbol_code& sym );
+
+         /// `st` is the stats row of the symbol the calling action already loaded
+         template<typename Stats>
+         void sub_balance( name owner, asset value, const Stats& st );
+         template<typename Stats>
+         void add_balance( name owner, asset value, name ram_payer, const Stats& st );
+
+         bool is_frozen( name owner );
+         uint64_t frozen_count();
+         void set_frozen_count( uint64_t count );
+
+         static constexpr name accounts_table = "accounts"_n;
+         static constexpr name stats_table    = "stat"_n;
+         static constexpr name balances_table = "balances"_n;
+
+         /// `accounts` and `stat` rows both start with an asset, which is all that is copied out
+         static asset read_leading_asset( int32_t itr )
+         {
+            uint64_t raw[2];
+            eosio_assert( db_get_i64( itr, raw, sizeof(raw) ) >= int32_t(sizeof(raw)), "unknown row format" );
+            return asset( int64_t(raw[0]), symbol(raw[1]) );
+         }
+
+         static asset read_leading_asset( name token_contract_account, uint64_t scope, name table, uint64_t primary_key )
+         {
+            auto itr = db_find_i64( token_contract_account.value, scope, table.value, primary_key );
+            eosio_assert( itr >= 0, "unable to find key" );
+            return read_leading_asset( itr );
+         }
+
+         static int32_t find_compact_balance( name token_contract_account, name owner, const symbol_code& sym )
+         {
+            return db_find_i64( token_contract_account.value, owner.value, balances_table.value, sym.raw() );
+         }
+
+         static int64_t read_compact_balance( int32_t itr )
+         {
+            int64_t amount;
+            eosio_assert( db_get_i64( itr, &amount, sizeof(amount) ) == sizeof(amount), "unknown balance row format" );
+            return amount;
+         }
+
+         int32_t migrate_balance( name owner, const symbol_code& sym );
+
+         template<typename Stats>
+         void checkpoint_balance( name owner, const asset& balance, name ram_payer, const Stats& st );
+         template<typename Stats>
+         void update_holder( name owner, const asset& balance, name ram_payer, const Stats& st );
+
+      private:
+         std::optional<uint64_t> _frozen_count;
+   };
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::create( name issuer, asset maximum_supply )
+   {
+      require_auth( _self );
+
+      auto sym = maximum_supply.symbol;
+      eosio_assert( sym.is_valid(), "invalid symbol name" );
+      if constexpr( Policy::enforce_precision ) {
+         eosio_assert( sym.precision() == Policy::precision, "invalid precision");
+      }
+      eosio_assert( maximum_supply.is_valid(), "invalid supply");
+      eosio_assert( maximum_supply.amount > 0, "max-supply must be positive");
+
+      typename Contract::stats statstable( _self, sym.code().raw() );
+      auto existing = statstable.find( sym.code().raw() );
+      eosio_assert( existing == statstable.end(), "token with symbol already exists" );
+
+      statstable.emplace( _self, [&]( auto& s ) {
+         s.supply.symbol = maximum_supply.symbol;
+         s.max_supply    = maximum_supply;
+         s.issuer        = issuer;
+      });
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::issue( name to, asset quantity, const string& memo )
+   {
+      auto sym = quantity.symbol;
+      eosio_assert( sym.is_valid(), "invalid symbol name" );
+      eosio_assert( memo.size() <= 256, "memo has more than 256 bytes" );
+
+      typename Contract::stats statstable( _self, sym.code().raw() );
+      auto existing = statstable.find( sym.code().raw() );
+      eosio_assert( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
+      const auto& st = *existing;
+
+      require_auth( st.issuer );
+      eosio_assert( quantity.is_valid(), "invalid quantity" );
+      eosio_assert( quantity.amount > 0, "must issue positive quantity" );
+
+      eosio_assert( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+      eosio_assert( quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
+
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+         s.supply += quantity;
+      });
+
+      add_balance( st.issuer, quantity, st.issuer, st );
+
+      if( to != st.issuer ) {
+         INLINE_ACTION_SENDER(Contract, transfer)( _self, { {st.issuer, "active"_n} },
+                                                   { st.issuer, to, quantity, memo }
+         );
+      }
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::issuemany( const std::vector<issue_item>& issues, const string& memo )
+   {
+      eosio_assert( issues.size() > 0, "no issues specified" );
+      eosio_assert( memo.size() <= 256, "memo has more than 256 bytes" );
+
+      auto sym = issues.front().quantity.symbol;
+      eosio_assert( sym.is_valid(), "invalid symbol name" );
+
+      typename Contract::stats statstable( _self, sym.code().raw() );
+      auto existing = statstable.find( sym.code().raw() );
+      eosio_assert( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
+      const auto& st = *existing;
+
+      require_auth( st.issuer );
+
+      int64_t total = 0;
+      for( const auto& i : issues ) {
+         eosio_assert( i.quantity.is_valid(), "invalid quantity" );
+         eosio_assert( i.quantity.amount > 0, "must issue positive quantity" );
+         eosio_assert( i.quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+         eosio_assert( is_account( i.to ), "to account does not exist");
+         if constexpr( Policy::pausable ) {
+            eosio_assert( st.paused == false || i.to == st.issuer, "token is paused" );
+         }
+
+         total += i.quantity.amount;
+         eosio_assert( total <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
+      }
+
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+         s.supply.amount += total;
+      });
+
+      for( const auto& i : issues ) {
+         require_recipient( i.to );
+         add_balance( i.to, i.quantity, st.issuer, st );
+      }
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::retire( asset quantity, const string& memo )
+   {
+      auto sym = quantity.symbol;
+      eosio_assert( sym.is_valid(), "invalid symbol name" );
+      eosio_assert( memo.size() <= 256, "memo has more than 256 bytes" );
+
+      typename Contract::stats statstable( _self, sym.code().raw() );
+      auto existing = statstable.find( sym.code().raw() );
+      eosio_assert( existing != statstable.end(), "token with symbol does not exist" );
+      const auto& st = *existing;
+
+      require_auth( st.issuer );
+      eosio_assert( quantity.is_valid(), "invalid quantity" );
+      eosio_assert( quantity.amount > 0, "must retire positive quantity" );
+
+      eosio_assert( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+         s.supply -= quantity;
+      });
+
+      sub_balance( st.issuer, quantity, st );
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::transfer( name from, name to, asset quantity, const string& memo )
+   {
+      eosio_assert( from != to, "cannot transfer to self" );
+      require_auth( from );
+      eosio_assert( is_account( to ), "to account does not exist");
+      auto sym = quantity.symbol.code();
+      typename Contract::stats statstable( _self, sym.raw() );
+      const auto& st = statstable.get( sym.raw() );
+
+      require_recipient( from );
+      require_recipient( to );
+
+      eosio_assert( quantity.is_valid(), "invalid quantity" );
+      eosio_assert( quantity.amount > 0, "must transfer positive quantity" );
+      eosio_assert( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+      eosio_assert( memo.size() <= 256, "memo has more than 256 bytes" );
+      if constexpr( Policy::pausable ) {
+         eosio_assert( st.paused == false, "token is paused" );
+      }
+
+      auto payer = has_auth( to ) ? to : from;
+
+      sub_balance( from, quantity, st );
+      add_balance( to, quantity, payer, st );
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::transferbatch( name from, const std::vector<transfer_item>& transfers )
+   {
+      require_auth( from );
+      eosio_assert( transfers.size() > 0, "no transfers specified" );
+
+      require_recipient( from );
+
+      std::map<symbol, int64_t> totals;
+      for( const auto& t : transfers ) {
+         eosio_assert( from != t.to, "cannot transfer to self" );
+         eosio_assert( is_account( t.to ), "to account does not exist");
+         eosio_assert( t.quantity.is_valid(), "invalid quantity" );
+         eosio_assert( t.quantity.amount > 0, "must transfer positive quantity" );
+         eosio_assert( t.memo.size() <= 256, "memo has more than 256 bytes" );
+
+         require_recipient( t.to );
+
+         auto& total = totals[t.quantity.symbol];
+         total += t.quantity.amount;
+         eosio_assert( total <= asset::max_amount, "total transfer amount overflow" );
+      }
+
+      // each stats row is read once and handed to every balance change of its symbol
+      std::map<symbol, typename Contract::currency_stats> stats_rows;
+      for( const auto& t : totals ) {
+         typename Contract::stats statstable( _self, t.first.code().raw() );
+         const auto& st = statstable.get( t.first.code().raw() );
+
+         eosio_assert( t.first == st.supply.symbol, "symbol precision mismatch" );
+         if constexpr( Policy::pausable ) {
+            eosio_assert( st.paused == false, "token is paused" );
+         }
+
+         sub_balance( from, asset( t.second, t.first ), st );
+         stats_rows.emplace( t.first, st );
+      }
+
+      for( const auto& t : transfers ) {
+         auto payer = has_auth( t.to ) ? t.to : from;
+         add_balance( t.to, t.quantity, payer, stats_rows.at( t.quantity.symbol ) );
+      }
+   }
+
+   template<typename Contract, typename Policy>
+   template<typename Stats>
+   void basic_token<Contract, Policy>::sub_balance( name owner, asset value, const Stats& st )
+   {
+      if constexpr( Policy::freezable ) {
+         eosio_assert( !is_frozen(owner), "account is frozen");
+      }
+
+      bool compact = false;
+      if constexpr( Policy::compact_balances ) {
+         compact = st.compact_balances.value_or(false);
+      }
+
+      asset new_balance;
+      int32_t itr = -1;
+      if( compact ) {
+         itr = find_compact_balance( _self, owner, value.symbol.code() );
+         if( itr < 0 ) {
+            itr = migrate_balance( owner, value.symbol.code() );
+         }
+      }
+
+      if( itr >= 0 ) {
+         new_balance = asset( read_compact_balance( itr ), value.symbol );
+         eosio_assert( new_balance.amount >= value.amount, "overdrawn balance" );
+         new_balance -= value;
+
+         db_update_i64( itr, owner.value, &new_balance.amount, sizeof(new_balance.amount) );
+      } else {
+         typename Contract::accounts from_acnts( _self, owner.value );
+
+         const auto& from = from_acnts.get( value.symbol.code().raw(), "no balance object found" );
+         eosio_assert( from.balance.amount >= value.amount, "overdrawn balance" );
+
+         from_acnts.modify( from, owner, [&]( auto& a ) {
+            a.balance -= value;
+         });
+         new_balance = from.balance;
+      }
+
+      if constexpr( Policy::checkpoints ) {
+         checkpoint_balance( owner, new_balance + value, owner, st );
+      }
+      if constexpr( Policy::holder_index ) {
+         update_holder( owner, new_balance, owner, st );
+      }
+
+      if constexpr( Policy::sync_ram_limits ) {
+         if( value.symbol == Policy::ram_symbol ) {
+            Policy::on_ram_balance_change( _self, owner, new_balance + value, new_balance );
+         }
+      }
+   }
+
+   template<typename Contract, typename Policy>
+   template<typename Stats>
+   void basic_token<Contract, Policy>::add_balance( name owner, asset value, name ram_payer, const Stats& st )
+   {
+      if constexpr( Policy::freezable ) {
+         eosio_assert( !is_frozen(owner), "account is frozen");
+      }
+
+      bool compact = false;
+      if constexpr( Policy::compact_balances ) {
+         compact = st.compact_balances.value_or(false);
+      }
+
+      asset old_balance( 0, value.symbol );
+      asset new_balance;
+      int32_t itr = compact ? find_compact_balance( _self, owner, value.symbol.code() ) : -1;
+      if( itr >= 0 ) {
+         old_balance.amount = read_compact_balance( itr );
+         new_balance = old_balance + value;
+         db_update_i64( itr, same_payer.value, &new_balance.amount, sizeof(new_balance.amount) );
+      } else {
+         typename Contract::accounts to_acnts( _self, owner.value );
+         auto to = to_acnts.find( value.symbol.code().raw() );
+         if( to != to_acnts.end() ) {
+            // a legacy row stays in accounts with its payer, only its owner's sub_balance moves it
+            old_balance = to->balance;
+            to_acnts.modify( to, same_payer, [&]( auto& a ) {
+               a.balance += value;
+            });
+            new_balance = to->balance;
+         } else if( compact ) {
+            new_balance = value;
+            db_store_i64( owner.value, balances_table.value, ram_payer.value, value.symbol.code().raw(),
+                          &new_balance.amount, sizeof(new_balance.amount) );
+         } else {
+            to = to_acnts.emplace( ram_payer, [&]( auto& a ){
+               a.balance = value;
+            });
+            new_balance = to->balance;
+         }
+      }
+
+      if constexpr( Policy::checkpoints ) {
+         checkpoint_balance( owner, old_balance, ram_payer, st );
+      }
+      if constexpr( Policy::holder_index ) {
+         update_holder( owner, new_balance, ram_payer, st );
+      }
+
+      if constexpr( Policy::sync_ram_limits ) {
+         if( value.symbol == Policy::ram_symbol ) {
+            Policy::on_ram_balance_change( _self, owner, old_balance, new_balance );
+         }
+      }
+   }
+
+   template<typename Contract, typename Policy>
+   int32_t basic_token<Contract, Policy>::migrate_balance( name owner, const symbol_code& sym )
+   {
+      // only called for a balance the owner is sending, so the owner pays for the new row
+      typename Contract::accounts acnts( _self, owner.value );
+      auto it = acnts.find( sym.raw() );
+      if( it == acnts.end() )
+         return -1;
+
+      int64_t amount = it->balance.amount;
+      acnts.erase( it );
+      return db_store_i64( owner.value, balances_table.value, owner.value, sym.raw(), &amount, sizeof(amount) );
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::open( name owner, const symbol& symbol, name ram_payer )
+   {
+      require_auth( ram_payer );
+
+      auto sym_code_raw = symbol.code().raw();
+
+      typename Contract::stats statstable( _self, sym_code_raw );
+      const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
+      eosio_assert( st.supply.symbol == symbol, "symbol precision mismatch" );
+
+      if constexpr( Policy::compact_balances ) {
+         if( find_compact_balance( _self, owner, symbol.code() ) >= 0 )
+            return;
+      }
+
+      typename Contract::accounts acnts( _self, owner.value );
+      auto it = acnts.find( sym_code_raw );
+      if( it == acnts.end() ) {
+         bool compact = false;
+         if constexpr( Policy::compact_balances ) {
+            compact = st.compact_balances.value_or(false);
+         }
+
+         if( compact ) {
+            int64_t amount = 0;
+            db_store_i64( owner.value, balances_table.value, ram_payer.value, sym_code_raw, &amount, sizeof(amount) );
+         } else {
+            acnts.emplace( ram_payer, [&]( auto& a ){
+               a.balance = asset{0, symbol};
+            });
+         }
+      }
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::close( name owner, const symbol& symbol )
+   {
+      if constexpr( Policy::freezable ) {
+         eosio_assert( !is_frozen(owner), "account is frozen");
+      }
+
+      require_auth( owner );
+
+      if constexpr( Policy::compact_balances ) {
+         auto itr = find_compact_balance( _self, owner, symbol.code() );
+         if( itr >= 0 ) {
+            eosio_assert( read_compact_balance( itr ) == 0, "Cannot close because the balance is not zero." );
+            db_remove_i64( itr );
+            return;
+         }
+      }
+
+      typename Contract::accounts acnts( _self, owner.value );
+      auto it = acnts.find( symbol.code().raw() );
+      eosio_assert( it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect." );
+      eosio_assert( it->balance.amount == 0, "Cannot close because the balance is not zero." );
+      acnts.erase( it );
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::freeze( name account )
+   {
+      static_assert( Policy::freezable, "token policy does not support freezing" );
+      require_auth( _self );
+
+      typename Contract::frozen_accounts frozen( _self, _self.value );
+      auto fitr = frozen.find( account.value );
+      eosio_assert( fitr == frozen.end(), "account already freezed");
+
+      // read before the emplace, the fallback of frozen_count() counts the rows of the table
+      const uint64_t count = frozen_count();
+
+      frozen.emplace( _self, [&]( auto& fa ) {
+         fa.account = account;
+      });
+
+      set_frozen_count( count + 1 );
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::unfreeze( name account )
+   {
+      static_assert( Policy::freezable, "token policy does not support freezing" );
+      require_auth( _self );
+
+      typename Contract::frozen_accounts frozen( _self, _self.value );
+      auto fitr = frozen.find( account.value );
+      eosio_assert( fitr != frozen.end(), "account not freezed");
+
+      // read before the erase, the fallback of frozen_count() counts the rows of the table
+      const uint64_t count = frozen_count();
+      eosio_assert( count > 0, "frozen account count is out of sync" ); // should never happen
+
+      frozen.erase(fitr);
+
+      set_frozen_count( count - 1 );
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::pause( const symbol_code& sym )
+   {
+      static_assert( Policy::pausable, "token policy does not support pausing" );
+      require_auth( _self );
+
+      typename Contract::stats statstable( _self, sym.raw() );
+      const auto& st = statstable.get( sym.raw() );
+
+      eosio_assert( st.paused == false, "token already paused" );
+
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+         s.paused = true;
+      });
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::unpause( const symbol_code& sym )
+   {
+      static_assert( Policy::pausable, "token policy does not support pausing" );
+      require_auth( _self );
+
+      typename Contract::stats statstable( _self, sym.raw() );
+      const auto& st = statstable.get( sym.raw() );
+
+      eosio_assert( st.paused == true, "token not paused" );
+
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+         s.paused = false;
+      });
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::checkpoint( const symbol_code& sym )
+   {
+      static_assert( Policy::checkpoints, "token policy does not keep checkpoints" );
+
+      typename Contract::stats statstable( _self, sym.raw() );
+      const auto& st = statstable.get( sym.raw(), "symbol does not exist" );
+
+      require_auth( st.issuer );
+
+      uint64_t epoch = st.epoch.value_or(0) + 1;
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+         s.epoch.emplace( epoch );
+      });
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::trackholders( const symbol_code& sym, bool track )
+   {
+      static_assert( Policy::holder_index, "token policy does not keep a holder index" );
+
+      typename Contract::stats statstable( _self, sym.raw() );
+      const auto& st = statstable.get( sym.raw(), "symbol does not exist" );
+
+      require_auth( st.issuer );
+      eosio_assert( st.track_holders.value_or(false) != track, track ? "holders already tracked" : "holders not tracked" );
+
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+         // binary extensions are serialized in order, so epoch needs a value first
+         if( !s.epoch ) {
+            s.epoch.emplace( 0 );
+         }
+         s.track_holders.emplace( track );
+      });
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::syncholder( name owner, const symbol_code& sym )
+   {
+      static_assert( Policy::holder_index, "token policy does not keep a holder index" );
+
+      typename Contract::stats statstable( _self, sym.raw() );
+      const auto& st = statstable.get( sym.raw(), "symbol does not exist" );
+
+      require_auth( st.issuer );
+
+      auto balance = get_balances( _self, owner, { sym } ).front();
+      if( st.track_holders.value_or(false) ) {
+         update_holder( owner, balance, st.issuer, st );
+      } else {
+         // tracking was turned off, drop what is left of the index
+         typename Contract::holders holderstable( _self, sym.raw() );
+         auto it = holderstable.find( owner.value );
+         eosio_assert( it != holderstable.end(), "holder not found" );
+         holderstable.erase( it );
+      }
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::compactbal( const symbol_code& sym )
+   {
+      static_assert( Policy::compact_balances, "token policy does not support compact balances" );
+
+      typename Contract::stats statstable( _self, sym.raw() );
+      const auto& st = statstable.get( sym.raw(), "symbol does not exist" );
+
+      require_auth( st.issuer );
+      eosio_assert( !st.compact_balances.value_or(false), "balances already compact" );
+
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+         // binary extensions are serialized in order, so the ones before need a value first
+         if( !s.epoch ) {
+            s.epoch.emplace( 0 );
+         }
+         if constexpr( Policy::holder_index ) {
+            if( !s.track_holders ) {
+               s.track_holders.emplace( false );
+            }
+         }
+         s.compact_balances.emplace( true );
+      });
+   }
+
+   template<typename Contract, typename Policy>
+   template<typename Stats>
+   void basic_token<Contract, Policy>::checkpoint_balance( name owner, const asset& balance, name ram_payer, const Stats& st )
+   {
+      auto sym = balance.symbol.code();
+      auto epoch = st.epoch.value_or(0);
+      if( epoch == 0 )
+         return;
+
+      typename Contract::balance_checkpoints history( _self, owner.value );
+      auto idx = history.template get_index<"byepoch"_n>();
+      if( idx.find( Contract::balance_checkpoint::epoch_key( sym, epoch ) ) != idx.end() )
+         return;
+
+      auto id = history.available_primary_key();
+      history.emplace( ram_payer, [&]( auto& c ) {
+         c.id     = id;
+         c.sym    = sym;
+         c.epoch  = epoch;
+         c.amount = balance.amount;
+      });
+   }
+
+   template<typename Contract, typename Policy>
+   template<typename Stats>
+   void basic_token<Contract, Policy>::update_holder( name owner, const asset& balance, name ram_payer, const Stats& st )
+   {
+      auto sym = balance.symbol.code();
+      if( !st.track_holders.value_or(false) )
+         return;
+
+      typename Contract::holders holderstable( _self, sym.raw() );
+      auto it = holderstable.find( owner.value );
+      if( balance.amount == 0 ) {
+         if( it != holderstable.end() ) {
+            holderstable.erase( it );
+         }
+      } else if( it == holderstable.end() ) {
+         holderstable.emplace( ram_payer, [&]( auto& h ) {
+            h.owner  = owner;
+            h.amount = balance.amount;
+         });
+      } else {
+         holderstable.modify( it, same_payer, [&]( auto& h ) {
+            h.amount = balance.amount;
+         });
+      }
+   }
+
+   template<typename Contract, typename Policy>
+   bool basic_token<Contract, Policy>::is_frozen( name owner )
+   {
+      if( frozen_count() == 0 )
+         return false;
+
+      typename Contract::frozen_accounts frozen( _self, _self.value );
+      return frozen.find(owner.value) != frozen.end();
+   }
+
+   template<typename Contract, typename Policy>
+   uint64_t basic_token<Contract, Policy>::frozen_count()
+   {
+      if( !_frozen_count ) {
+         typename Contract::frozen_stats_singleton fstats( _self, _self.value );
+         if( fstats.exists() ) {
+            _frozen_count = fstats.get().count;
+         } else {
+            // deployed before frozenstat existed, count the rows until the next freeze/unfreeze stores it
+            typename Contract::frozen_accounts frozen( _self, _self.value );
+            _frozen_count = std::distance( frozen.begin(), frozen.end() );
+         }
+      }
+      return *_frozen_count;
+   }
+
+   template<typename Contract, typename Policy>
+   void basic_token<Contract, Policy>::set_frozen_count( uint64_t count )
+   {
+      typename Contract::frozen_stats_singleton fstats( _self, _self.value );
+      fstats.set( typename Contract::frozen_stats{ count }, _self );
+      _frozen_count = count;
+   }
+
+} /// namespace eosio
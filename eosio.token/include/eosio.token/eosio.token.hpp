@@ -5,9 +5,14 @@
 #pragma once
 
 #include <eosiolib/asset.hpp>
+#include <eosiolib/binary_extension.hpp>
 #include <eosiolib/eosio.hpp>
+#include <eosiolib/singleton.hpp>
+
+#include <eosio.token/basic_token.hpp>
 
 #include <string>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -17,14 +22,23 @@ namespace eosio {
 
    using std::string;
 
-   class [[eosio::contract("eosio.token")]] token : public contract {
-      public:
-         using contract::contract;
+   struct token_policy : default_token_policy {
+      static constexpr bool    enforce_precision = true;
+      static constexpr uint8_t precision         = 8;
+      static constexpr bool    sync_ram_limits   = true;
+      static constexpr bool    compact_balances  = true;
+      static constexpr bool    checkpoints       = true;
+      static constexpr bool    holder_index      = true;
+      static constexpr symbol  ram_symbol        = symbol(symbol_code("RAM"), 8);
 
-         static constexpr symbol RAM_SYMBOL = symbol(symbol_code("RAM"), 8);
+      static void on_ram_balance_change( name token_contract, name owner, const asset& old_balance, const asset& new_balance );
+   };
+
+   class [[eosio::contract("eosio.token")]] token : public basic_token<token, token_policy> {
+      public:
+         using basic_token::basic_token;
 
-         token( name receiver, name code, datastream<const char*> ds ) : contract(receiver, code, ds),
-          _frozen_accounts(_self, _self.value){ }
+         static constexpr symbol RAM_SYMBOL = token_policy::ram_symbol;
 
          [[eosio::action]]
          void create( name   issuer,
@@ -33,6 +47,14 @@ namespace eosio {
          [[eosio::action]]
          void issue( name to, asset quantity, string memo );
 
+         /**
+          *  Issues to many recipients in one action. The supply is checked against and
+          *  updated by the total once, and recipients are credited directly instead of
+          *  through an inline transfer from the issuer.
+          */
+         [[eosio::action]]
+         void issuemany( const std::vector<issue_item>& issues, string memo );
+
          [[eosio::action]]
          void retire( asset quantity, string memo );
 
@@ -42,6 +64,14 @@ namespace eosio {
                         asset   quantity,
                         string  memo );
 
+         /**
+          *  Transfers to many recipients in one action. The stats row of every symbol
+          *  involved is read once and 'from' is debited once per symbol for the total.
+          *  Recipients are notified of the transferbatch action, not of individual transfers.
+          */
+         [[eosio::action]]
+         void transferbatch( name from, const std::vector<transfer_item>& transfers );
+
          [[eosio::action]]
          void open( name owner, const symbol& symbol, name ram_payer );
 
@@ -60,19 +90,52 @@ namespace eosio {
          [[eosio::action]]
          void unpause( const symbol_code& symbol );
 
-         static asset get_supply( name token_contract_account, symbol_code sym_code )
-         {
-            stats statstable( token_contract_account, sym_code.raw() );
-            const auto& st = statstable.get( sym_code.raw() );
-            return st.supply;
-         }
+         /**
+          *  Takes snapshot number `epoch + 1` of the balances of 'symbol', which balance_at can
+          *  answer for from then on. Only the issuer may take snapshots.
+          */
+         [[eosio::action]]
+         void checkpoint( const symbol_code& symbol );
+
+         /**
+          *  Turns the `holders` table of 'symbol' on or off. Only the issuer may do this and
+          *  pays for the rows syncholder adds for balances that predate tracking.
+          */
+         [[eosio::action]]
+         void trackholders( const symbol_code& symbol, bool track );
+
+         /**
+          *  Brings the `holders` row of 'owner' in line with its balance, or removes it once
+          *  tracking of 'symbol' has been turned off.
+          */
+         [[eosio::action]]
+         void syncholder( name owner, const symbol_code& symbol );
 
-         static asset get_balance( name token_contract_account, name owner, symbol_code sym_code )
-         {
-            accounts accountstable( token_contract_account, owner.value );
-            const auto& ac = accountstable.get( sym_code.raw() );
-            return ac.balance;
-         }
+         /**
+          *  Stores the balances of 'symbol' in the compact `balances` table from now on. Only
+          *  the issuer may do this, and it cannot be undone: moved balances are no longer in
+          *  `accounts`, where get_currency_balance and other off-chain readers look for them.
+          */
+         [[eosio::action]]
+         void compactbal( const symbol_code& symbol );
+
+         /**
+          *  Called by the system contract from setacctram, setacctres and mirrorram to mirror the
+          *  ram_managed flag of 'account', so that RAM token balance changes don't have to read
+          *  eosio's voters table. Only unmanaged accounts have a row; a missing row means managed,
+          *  like a missing voters row does in the system contract.
+          */
+         [[eosio::action]]
+         void setrammanage( name account, bool managed );
+
+         struct [[eosio::table]] ram_managed_account {
+            name     account;
+            bool     managed = true;
+
+            uint64_t primary_key()const { return account.value; }
+         };
+
+         typedef eosio::multi_index< "rammanaged"_n, ram_managed_account > ram_managed_accounts;
 
       private:
          struct [[eosio::table]] account {
@@ -81,30 +144,82 @@ namespace eosio {
             uint64_t primary_key()const { return balance.symbol.code().raw(); }
          };
 
+         /**
+          *  Row of the `balances` table, which replaces `accounts` for symbols moved there with
+          *  compactbal. Its primary key is the symbol code; rows are read and written with the
+          *  db_*_i64 intrinsics by basic_token.
+          */
+         struct [[eosio::table("balances")]] compact_account {
+            int64_t  amount;
+         };
+
          struct [[eosio::table]] currency_stats {
             asset    supply;
             asset    max_supply;
             name     issuer;
             bool     paused = false;
+            binary_extension<uint64_t> epoch;             ///< number of the last checkpoint, absent until the first one
+            binary_extension<bool>     track_holders;     ///< maintain the `holders` table of this symbol
+            binary_extension<bool>     compact_balances;  ///< new and sent balances go to the `balances` table
 
             uint64_t primary_key()const { return supply.symbol.code().raw(); }
          };
 
+         /**
+          *  Balance of the scope's owner when checkpoint `epoch` of `sym` was taken, stored by
+          *  the first change of that balance after the checkpoint.
+          */
+         struct [[eosio::table]] balance_checkpoint {
+            uint64_t     id;
+            symbol_code  sym;
+            uint64_t     epoch;
+            int64_t      amount;
+
+            uint64_t primary_key()const { return id; }
+            uint128_t by_epoch()const { return epoch_key( sym, epoch ); }
+
+            static uint128_t epoch_key( symbol_code sym, uint64_t epoch ) {
+               return (uint128_t(sym.raw()) << 64) | epoch;
+            }
+         };
+
          struct [[eosio::table]] frozen_account {
             name     account;
 
             uint64_t primary_key()const { return account.value; }
          };
 
+         /**
+          *  Number of rows in the frozen table, kept by freeze/unfreeze so that
+          *  balance changes can skip the frozen lookup while nobody is frozen.
+          */
+         struct [[eosio::table("frozenstat")]] frozen_stats {
+            uint64_t count = 0;
+         };
+
+         /**
+          *  Holder of the symbol the table is scoped by. `byamount` sorts by descending amount.
+          */
+         struct [[eosio::table]] holder {
+            name     owner;
+            int64_t  amount;
+
+            uint64_t primary_key()const { return owner.value; }
+            uint64_t by_amount()const { return static_cast<uint64_t>( asset::max_amount - amount ); }
+         };
+
          typedef eosio::multi_index< "accounts"_n, account > accounts;
          typedef eosio::multi_index< "stat"_n, currency_stats > stats;
          typedef eosio::multi_index< "frozen"_n, frozen_account > frozen_accounts;
-
-         void sub_balance( name owner, asset value );
-         void add_balance( name owner, asset value, name ram_payer );
-
-         frozen_accounts _frozen_accounts;
-         bool is_frozen( name owner );
+         typedef eosio::singleton< "frozenstat"_n, frozen_stats > frozen_stats_singleton;
+         typedef eosio::multi_index< "checkpoints"_n, balance_checkpoint,
+                                     indexed_by<"byepoch"_n, const_mem_fun<balance_checkpoint, uint128_t, &balance_checkpoint::by_epoch> >
+                                   > balance_checkpoints;
+         typedef eosio::multi_index< "holders"_n, holder,
+                                     indexed_by<"byamount"_n, const_mem_fun<holder, uint64_t, &holder::by_amount> >
+                                   > holders;
+
+         friend class basic_token<token, token_policy>;
    };
 
 } /// namespace eosio
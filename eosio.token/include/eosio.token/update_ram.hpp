@@ -1,18 +1,16 @@
 #pragma once
 
 #include <eosio.system/eosio.system.hpp>
+#include <eosio.token/eosio.token.hpp>
 #include <eosiolib/privileged.h>
 
 using namespace  eosio;
 
-bool has_ram_managed( const name& account ) {
+bool has_ram_managed( const name& token_contract, const name& account ) {
 
-   eosiosystem::voters_table _voters("eosio"_n, "eosio"_n.value);
-   auto vitr = _voters.find( account.value );
-   if( vitr == _voters.end() )
-      return true;
-   
-   return eosiosystem::has_field( vitr->flags1, eosiosystem::voter_info::flags1_fields::ram_managed );
+   // the system contract mirrors only unmanaged accounts, see token::setrammanage
+   eosio::token::ram_managed_accounts _managed(token_contract, token_contract.value);
+   return _managed.find( account.value ) == _managed.end();
 }
 
 int64_t ram_balance_to_bytes(const asset& ram_balance) {
@@ -26,13 +24,17 @@ int64_t ram_balance_to_bytes(const asset& ram_balance) {
    return static_cast<int64_t>(new_ram_bytes);
 }
 
-void update_account_ram_limit(const name& account, const asset& ram_balance) {
-
-   if( has_ram_managed(account) )
-      return;
+void update_account_ram_limit(const name& token_contract, const name& account, const asset& new_ram_balance) {
 
+   // compared with the current limit, so that a limit set by other means is corrected as well
+   int64_t new_ram_bytes = ram_balance_to_bytes(new_ram_balance);
    int64_t ram_bytes, net, cpu;
    get_resource_limits( account.value, &ram_bytes, &net, &cpu );
-   int64_t new_ram_bytes = ram_balance_to_bytes(ram_balance);
-   set_resource_limits( account.value, new_ram_bytes, net, cpu );      
+   if( new_ram_bytes == ram_bytes )
+      return;
+
+   if( has_ram_managed(token_contract, account) )
+      return;
+
+   set_resource_limits( account.value, new_ram_bytes, net, cpu );
 }
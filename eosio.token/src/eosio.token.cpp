@@ -8,82 +8,30 @@
 
 namespace eosio {
 
+void token_policy::on_ram_balance_change( name token_contract, name owner, const asset& old_balance, const asset& new_balance )
+{
+   update_account_ram_limit( token_contract, owner, new_balance );
+}
+
 void token::create( name   issuer,
                     asset  maximum_supply )
 {
-    require_auth( _self );
-
-    auto sym = maximum_supply.symbol;
-    eosio_assert( sym.is_valid(), "invalid symbol name" );
-    eosio_assert( sym.precision() == 8, "invalid precision");
-    eosio_assert( maximum_supply.is_valid(), "invalid supply");
-    eosio_assert( maximum_supply.amount > 0, "max-supply must be positive");
-
-    stats statstable( _self, sym.code().raw() );
-    auto existing = statstable.find( sym.code().raw() );
-    eosio_assert( existing == statstable.end(), "token with symbol already exists" );
-
-    statstable.emplace( _self, [&]( auto& s ) {
-       s.supply.symbol = maximum_supply.symbol;
-       s.max_supply    = maximum_supply;
-       s.issuer        = issuer;
-    });
+   basic_token::create( issuer, maximum_supply );
 }
 
-
 void token::issue( name to, asset quantity, string memo )
 {
-    auto sym = quantity.symbol;
-    eosio_assert( sym.is_valid(), "invalid symbol name" );
-    eosio_assert( memo.size() <= 256, "memo has more than 256 bytes" );
-
-    stats statstable( _self, sym.code().raw() );
-    auto existing = statstable.find( sym.code().raw() );
-    eosio_assert( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
-    const auto& st = *existing;
-
-    require_auth( st.issuer );
-    eosio_assert( quantity.is_valid(), "invalid quantity" );
-    eosio_assert( quantity.amount > 0, "must issue positive quantity" );
-
-    eosio_assert( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-    eosio_assert( quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
-
-    statstable.modify( st, same_payer, [&]( auto& s ) {
-       s.supply += quantity;
-    });
-
-    add_balance( st.issuer, quantity, st.issuer );
+   basic_token::issue( to, quantity, memo );
+}
 
-    if( to != st.issuer ) {
-      SEND_INLINE_ACTION( *this, transfer, { {st.issuer, "active"_n} },
-                          { st.issuer, to, quantity, memo }
-      );
-    }
+void token::issuemany( const std::vector<issue_item>& issues, string memo )
+{
+   basic_token::issuemany( issues, memo );
 }
 
 void token::retire( asset quantity, string memo )
 {
-    auto sym = quantity.symbol;
-    eosio_assert( sym.is_valid(), "invalid symbol name" );
-    eosio_assert( memo.size() <= 256, "memo has more than 256 bytes" );
-
-    stats statstable( _self, sym.code().raw() );
-    auto existing = statstable.find( sym.code().raw() );
-    eosio_assert( existing != statstable.end(), "token with symbol does not exist" );
-    const auto& st = *existing;
-
-    require_auth( st.issuer );
-    eosio_assert( quantity.is_valid(), "invalid quantity" );
-    eosio_assert( quantity.amount > 0, "must retire positive quantity" );
-
-    eosio_assert( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-
-    statstable.modify( st, same_payer, [&]( auto& s ) {
-       s.supply -= quantity;
-    });
-
-    sub_balance( st.issuer, quantity );
+   basic_token::retire( quantity, memo );
 }
 
 void token::transfer( name    from,
@@ -91,153 +39,83 @@ void token::transfer( name    from,
                       asset   quantity,
                       string  memo )
 {
-    eosio_assert( from != to, "cannot transfer to self" );
-    require_auth( from );
-    eosio_assert( is_account( to ), "to account does not exist");
-    auto sym = quantity.symbol.code();
-    stats statstable( _self, sym.raw() );
-    const auto& st = statstable.get( sym.raw() );
-
-    require_recipient( from );
-    require_recipient( to );
-
-    eosio_assert( quantity.is_valid(), "invalid quantity" );
-    eosio_assert( quantity.amount > 0, "must transfer positive quantity" );
-    eosio_assert( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-    eosio_assert( memo.size() <= 256, "memo has more than 256 bytes" );
-    eosio_assert( st.paused == false, "token is paused" );
-
-    auto payer = has_auth( to ) ? to : from;
-
-    sub_balance( from, quantity );
-    add_balance( to, quantity, payer );
+   basic_token::transfer( from, to, quantity, memo );
 }
 
-void token::sub_balance( name owner, asset value ) {
-   eosio_assert( !is_frozen(owner), "account is frozen");
-
-   accounts from_acnts( _self, owner.value );
-
-   const auto& from = from_acnts.get( value.symbol.code().raw(), "no balance object found" );
-   eosio_assert( from.balance.amount >= value.amount, "overdrawn balance" );
-
-   from_acnts.modify( from, owner, [&]( auto& a ) {
-      a.balance -= value;
-   });
-
-   // Handle special RAM toke case
-   if( value.symbol == RAM_SYMBOL ) {
-      update_account_ram_limit(owner, from.balance);
-   }
-}
-
-void token::add_balance( name owner, asset value, name ram_payer )
+void token::transferbatch( name from, const std::vector<transfer_item>& transfers )
 {
-   eosio_assert( !is_frozen(owner), "account is frozen");
-
-   accounts to_acnts( _self, owner.value );
-   auto to = to_acnts.find( value.symbol.code().raw() );
-   if( to == to_acnts.end() ) {
-      to = to_acnts.emplace( ram_payer, [&]( auto& a ){
-        a.balance = value;
-      });
-   } else {
-      to_acnts.modify( to, same_payer, [&]( auto& a ) {
-        a.balance += value;
-      });
-   }
-
-   // Handle special RAM toke case
-   if( value.symbol == RAM_SYMBOL ) {
-      update_account_ram_limit(owner, to->balance);
-   }
+   basic_token::transferbatch( from, transfers );
 }
 
 void token::open( name owner, const symbol& symbol, name ram_payer )
 {
-   require_auth( ram_payer );
-
-   auto sym_code_raw = symbol.code().raw();
-
-   stats statstable( _self, sym_code_raw );
-   const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
-   eosio_assert( st.supply.symbol == symbol, "symbol precision mismatch" );
-
-   accounts acnts( _self, owner.value );
-   auto it = acnts.find( sym_code_raw );
-   if( it == acnts.end() ) {
-      acnts.emplace( ram_payer, [&]( auto& a ){
-        a.balance = asset{0, symbol};
-      });
-   }
+   basic_token::open( owner, symbol, ram_payer );
 }
 
 void token::close( name owner, const symbol& symbol )
 {
-   eosio_assert( !is_frozen(owner), "account is frozen");
-
-   require_auth( owner );
-   accounts acnts( _self, owner.value );
-   auto it = acnts.find( symbol.code().raw() );
-   eosio_assert( it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect." );
-   eosio_assert( it->balance.amount == 0, "Cannot close because the balance is not zero." );
-   acnts.erase( it );
+   basic_token::close( owner, symbol );
 }
 
 void token::freeze( name account )
 {
-   require_auth( _self );
-
-   auto fitr = _frozen_accounts.find( account.value );
-   eosio_assert( fitr == _frozen_accounts.end(), "account already freezed");
-
-   _frozen_accounts.emplace( _self, [&]( auto& fa ) {
-      fa.account = account;
-   });
+   basic_token::freeze( account );
 }
 
 void token::unfreeze( name account )
 {
-   require_auth( _self );
-
-   auto fitr = _frozen_accounts.find( account.value );
-   eosio_assert( fitr != _frozen_accounts.end(), "account not freezed");
-
-   _frozen_accounts.erase(fitr);
+   basic_token::unfreeze( account );
 }
 
 void token::pause( const symbol_code& sym )
 {
-   require_auth( _self );
-
-   stats statstable( _self, sym.raw() );
-   const auto& st = statstable.get( sym.raw() );
-
-   eosio_assert( st.paused == false, "token already paused" );
-
-   statstable.modify( st, same_payer, [&]( auto& s ) {
-      s.paused = true;
-   });
+   basic_token::pause( sym );
 }
 
 void token::unpause( const symbol_code& sym )
 {
-   require_auth( _self );
+   basic_token::unpause( sym );
+}
 
-   stats statstable( _self, sym.raw() );
-   const auto& st = statstable.get( sym.raw() );
+void token::checkpoint( const symbol_code& sym )
+{
+   basic_token::checkpoint( sym );
+}
 
-   eosio_assert( st.paused == true, "token not paused" );
+void token::trackholders( const symbol_code& sym, bool track )
+{
+   basic_token::trackholders( sym, track );
+}
 
-   statstable.modify( st, same_payer, [&]( auto& s ) {
-      s.paused = false;
-   });
+void token::syncholder( name owner, const symbol_code& sym )
+{
+   basic_token::syncholder( owner, sym );
+}
+
+void token::compactbal( const symbol_code& sym )
+{
+   basic_token::compactbal( sym );
 }
 
-bool token::is_frozen( name owner ) {
-   return _frozen_accounts.find(owner.value) != _frozen_accounts.end();
+void token::setrammanage( name account, bool managed )
+{
+   require_auth( "eosio"_n );
+
+   // managed is the default of every account, so only unmanaged ones keep a row
+   ram_managed_accounts managed_tbl( _self, _self.value );
+   auto mitr = managed_tbl.find( account.value );
+   if( managed ) {
+      if( mitr != managed_tbl.end() ) {
+         managed_tbl.erase( mitr );
+      }
+   } else if( mitr == managed_tbl.end() ) {
+      managed_tbl.emplace( "eosio"_n, [&]( auto& m ) {
+         m.account = account;
+         m.managed = false;
+      });
+   }
 }
 
 } /// namespace eosio
 
-EOSIO_DISPATCH( eosio::token, (create)(issue)(transfer)(open)(close)(retire)(freeze)(unfreeze)(pause)(unpause) )
+EOSIO_DISPATCH( eosio::token, (create)(issue)(issuemany)(transfer)(transferbatch)(open)(close)(retire)(freeze)(unfreeze)(pause)(unpause)(checkpoint)(trackholders)(syncholder)(compactbal)(setrammanage) )
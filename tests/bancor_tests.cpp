@@ -0,0 +1,100 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio.system/bancor.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace eosiosystem;
+
+namespace {
+
+   /// reserves and amounts in the ranges seen by the RAM market
+   struct bancor_case {
+      int64_t supply;
+      int64_t balance;
+      int64_t in;
+      double  weight;
+   };
+
+   std::vector<bancor_case> random_cases( size_t count, bool from_exchange ) {
+      std::mt19937_64 gen( 0x5eed );
+      std::uniform_real_distribution<double> supply_exp( 9, 15 );
+      std::uniform_real_distribution<double> balance_exp( 6, 15 );
+      std::uniform_real_distribution<double> unit( 0, 1 );
+      std::uniform_real_distribution<double> weight( 0.1, 1 );
+
+      std::vector<bancor_case> cases;
+      for( size_t i = 0; i < count; ++i ) {
+         bancor_case c;
+         c.supply  = int64_t( std::pow( 10, supply_exp( gen ) ) );
+         c.balance = int64_t( std::pow( 10, balance_exp( gen ) ) );
+         c.weight  = i % 2 ? 0.5 : weight( gen );
+         const int64_t max_in = from_exchange ? c.supply / 10 : c.balance;
+         c.in = 1 + int64_t( unit( gen ) * ( max_in - 1 ) );
+         cases.push_back( c );
+      }
+      return cases;
+   }
+
+} /// namespace
+
+BOOST_AUTO_TEST_SUITE(bancor_tests)
+
+BOOST_AUTO_TEST_CASE( fixed_point_arithmetic ) {
+   BOOST_REQUIRE_EQUAL( int64_t( fixed_point( int64_t(7) ) * fixed_point( int64_t(6) ) ), 42 );
+   BOOST_REQUIRE_EQUAL( int64_t( fixed_point( int64_t(42) ) / fixed_point( int64_t(6) ) ), 7 );
+   BOOST_REQUIRE_EQUAL( int64_t( fixed_point( int64_t(1) ) - fixed_point( int64_t(3) ) ), -2 );
+   BOOST_REQUIRE_EQUAL( int64_t( fixed_point( -2.75 ) ), -2 );
+   const auto sqrt_error = ( pow( fixed_point( int64_t(9) ), fixed_point( 0.5 ) ) - fixed_point( int64_t(3) ) ).raw();
+   BOOST_REQUIRE( -( 1 << 20 ) < sqrt_error && sqrt_error < ( 1 << 20 ) ); // within 2^-44
+   BOOST_REQUIRE_EQUAL( int64_t( pow( fixed_point( int64_t(2) ), fixed_point( int64_t(40) ) ) ), int64_t(1) << 40 );
+   BOOST_REQUIRE( pow( fixed_point( int64_t(1) ), fixed_point( 0.3 ) ) == fixed_point( int64_t(1) ) );
+}
+
+BOOST_AUTO_TEST_CASE( matches_floating_point ) {
+   for( const auto& c : random_cases( 20000, false ) ) {
+      const int64_t fixed  = bancor_to_exchange<fixed_point>( c.supply, c.balance, c.in, c.weight );
+      const int64_t native = bancor_to_exchange<double>( c.supply, c.balance, c.in, c.weight );
+      const double  limit  = 2 + std::abs( double( native ) ) * 1e-12 + c.supply * 1e-15;
+      BOOST_REQUIRE_MESSAGE( std::abs( double( fixed - native ) ) <= limit,
+                             "to_exchange R=" << c.supply << " C=" << c.balance << " in=" << c.in << " F=" << c.weight
+                             << ": " << fixed << " != " << native );
+   }
+   for( const auto& c : random_cases( 20000, true ) ) {
+      const int64_t fixed  = bancor_from_exchange<fixed_point>( c.supply, c.balance, c.in, c.weight );
+      const int64_t native = bancor_from_exchange<double>( c.supply, c.balance, c.in, c.weight );
+      const double  limit  = 2 + std::abs( double( native ) ) * 1e-12 + c.balance * 1e-15;
+      BOOST_REQUIRE_MESSAGE( std::abs( double( fixed - native ) ) <= limit,
+                             "from_exchange R=" << c.supply << " C=" << c.balance << " in=" << c.in << " F=" << c.weight
+                             << ": " << fixed << " != " << native );
+   }
+}
+
+BOOST_AUTO_TEST_CASE( round_trip_never_gains ) {
+   for( const auto& c : random_cases( 5000, false ) ) {
+      const int64_t issued = bancor_to_exchange<fixed_point>( c.supply, c.balance, c.in, c.weight );
+      const int64_t out    = bancor_from_exchange<fixed_point>( c.supply + issued, c.balance + c.in, issued, c.weight );
+      BOOST_REQUIRE_LE( out, c.in );
+   }
+}
+
+BOOST_AUTO_TEST_CASE( timing ) {
+   const auto cases = random_cases( 20000, false );
+   auto time_ns = [&]( auto convert ) {
+      int64_t sink = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for( const auto& c : cases ) {
+         sink += convert( c );
+      }
+      const auto end = std::chrono::steady_clock::now();
+      BOOST_REQUIRE( sink != 0 );
+      return std::chrono::duration<double, std::nano>( end - start ).count() / cases.size();
+   };
+   const double fixed  = time_ns( []( const bancor_case& c ) { return bancor_to_exchange<fixed_point>( c.supply, c.balance, c.in, c.weight ); } );
+   const double native = time_ns( []( const bancor_case& c ) { return bancor_to_exchange<double>( c.supply, c.balance, c.in, c.weight ); } );
+   BOOST_TEST_MESSAGE( "bancor_to_exchange: fixed_point " << fixed << " ns, double " << native << " ns per call" );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
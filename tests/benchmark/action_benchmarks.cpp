@@ -0,0 +1,423 @@
+#include "benchmark_tester.hpp"
+
+using namespace eosio_benchmark;
+
+/// writes the measurements of this run to $BENCHMARK_OUTPUT, in the format of baseline.json
+struct benchmark_report {
+   ~benchmark_report() {
+      const char* path = std::getenv( "BENCHMARK_OUTPUT" );
+      if( !path )
+         return;
+
+      fc::mutable_variant_object out;
+      for( const auto& r : results() ) {
+         fc::variant v;
+         fc::to_variant( r.second, v );
+         out( r.first, v );
+      }
+      fc::json::save_to_file( fc::variant( out ), path, true );
+   }
+};
+
+BOOST_GLOBAL_FIXTURE( benchmark_report );
+
+BOOST_AUTO_TEST_SUITE(action_benchmarks)
+
+BOOST_FIXTURE_TEST_CASE( token_actions, benchmark_tester ) try {
+   const auto amount = asset( 100000000, core );
+
+   measure( "eosio.token::issue", N(eosio.token), N(issue), config::system_account_name, mvo()
+      ("to", "eosio")
+      ("quantity", amount)
+      ("memo", "")
+   );
+   measure( "eosio.token::transfer/new_row", N(eosio.token), N(transfer), config::system_account_name, mvo()
+      ("from", "eosio")
+      ("to", "alice1111111")
+      ("quantity", amount)
+      ("memo", "")
+   );
+   measure( "eosio.token::transfer", N(eosio.token), N(transfer), config::system_account_name, mvo()
+      ("from", "eosio")
+      ("to", "alice1111111")
+      ("quantity", amount)
+      ("memo", "")
+   );
+   measure( "eosio.token::open", N(eosio.token), N(open), N(alice1111111), mvo()
+      ("owner", "carol1111111")
+      ("symbol", core)
+      ("ram_payer", "alice1111111")
+   );
+   measure( "eosio.token::close", N(eosio.token), N(close), N(carol1111111), mvo()
+      ("owner", "carol1111111")
+      ("symbol", core)
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( tether_actions, benchmark_tester ) try {
+   // both tokens are built from basic_token, with different policies
+   BOOST_TEST_MESSAGE( "wasm size: eosio.token " << contracts::token_wasm().size() << " bytes, tether.token "
+                       << contracts::tether_wasm().size() << " bytes" );
+
+   create_sidechain_account( N(tether.token), 4 * 1024 * 1024 );
+   base_tester::push_action( config::system_account_name, N(setpriv), config::system_account_name, mvo()
+      ("account", "tether.token")
+      ("is_priv", 1)
+   );
+   set_code( N(tether.token), contracts::tether_wasm() );
+   set_abi( N(tether.token), contracts::tether_abi().data() );
+   produce_blocks();
+
+   const auto amount = asset( 100000000, symbol( 8, "USDT" ) );
+   base_tester::push_action( N(tether.token), N(create), N(tether.token), mvo()
+      ("issuer", "alice1111111")
+      ("maximum_supply", asset( 100000000000000ll, amount.get_symbol() ))
+   );
+   produce_block();
+
+   measure( "tether.token::issue", N(tether.token), N(issue), N(alice1111111), mvo()
+      ("to", "alice1111111")
+      ("quantity", amount + amount)
+      ("memo", "")
+   );
+   measure( "tether.token::transfer/new_row", N(tether.token), N(transfer), N(alice1111111), mvo()
+      ("from", "alice1111111")
+      ("to", "bob111111111")
+      ("quantity", amount)
+      ("memo", "")
+   );
+   measure( "tether.token::transfer", N(tether.token), N(transfer), N(alice1111111), mvo()
+      ("from", "alice1111111")
+      ("to", "bob111111111")
+      ("quantity", amount)
+      ("memo", "")
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( transferbatch, benchmark_tester ) try {
+   const auto quantity = asset( 100000000, core );
+   vector<account_name> accounts;
+   for( uint32_t i = 0; i < 50; ++i ) {
+      accounts.emplace_back( string( "recipient" ) + char( 'a' + i / 26 ) + char( 'a' + i % 26 ) );
+      create_sidechain_account( accounts.back() );
+   }
+   produce_blocks();
+
+   vector<action> single;
+   vector<fc::variant> transfers;
+   for( const auto& a : accounts ) {
+      single.emplace_back( get_action( N(eosio.token), N(transfer), {{config::system_account_name, config::active_name}}, mvo()
+         ("from", "eosio")
+         ("to", a)
+         ("quantity", quantity)
+         ("memo", "")
+      ) );
+      transfers.emplace_back( mvo()("to", a)("quantity", quantity)("memo", "") );
+   }
+   // the first run opens the balance rows, so both variants below only modify them
+   measure( "eosio.token::transfer/50_actions/new_rows", single, { config::system_account_name } );
+   measure( "eosio.token::transfer/50_actions", std::move( single ), { config::system_account_name } );
+   measure( "eosio.token::transferbatch/50_recipients", N(eosio.token), N(transferbatch), config::system_account_name, mvo()
+      ("from", "eosio")
+      ("transfers", transfers)
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( balance_rows_ram, benchmark_tester ) try {
+   // RAM grows linearly with the holders; 1000 by default, BENCHMARK_HOLDERS=1000000 for the full sidechain size
+   const char* env = std::getenv( "BENCHMARK_HOLDERS" );
+   const uint32_t holders = env ? std::atoi( env ) : 1000;
+   const uint32_t batch   = 100;
+
+   vector<account_name> accounts;
+   for( uint32_t i = 0; i < holders; ++i ) {
+      string n( "holder" );
+      for( uint32_t v = i, d = 0; d < 6; ++d, v /= 26 ) {
+         n += char( 'a' + v % 26 );
+      }
+      accounts.emplace_back( n );
+   }
+   for( uint32_t i = 0; i < holders; i += batch ) {
+      vector<fc::variant> created;
+      for( uint32_t j = i; j < std::min( i + batch, holders ); ++j ) {
+         created.emplace_back( mvo()
+            ("account", accounts[j])
+            ("owner", authority( get_public_key( accounts[j], "owner" ) ))
+            ("active", authority( get_public_key( accounts[j], "active" ) ))
+            ("ram_bytes", 8 * 1024)
+            ("net_weight", -1)
+            ("cpu_weight", -1)
+         );
+      }
+      base_tester::push_action( config::system_account_name, N(newaccounts), config::system_account_name, mvo()
+         ("creator", "eosio")
+         ("accounts", created)
+      );
+   }
+
+   // one balance row for each holder, issued by eosio, which pays for the rows
+   auto balance_rows = [&]( const symbol& sym, bool compact ) {
+      base_tester::push_action( N(eosio.token), N(create), config::system_account_name, mvo()
+         ("issuer", "eosio")
+         ("maximum_supply", asset( 100000000000000000ll, sym ))
+      );
+      if( compact ) {
+         base_tester::push_action( N(eosio.token), N(compactbal), config::system_account_name, mvo()
+            ("symbol", sym.name())
+         );
+      }
+
+      measurement m;
+      const auto ram_before = total_ram_usage();
+      for( uint32_t i = 0; i < holders; i += batch ) {
+         vector<fc::variant> issues;
+         for( uint32_t j = i; j < std::min( i + batch, holders ); ++j ) {
+            issues.emplace_back( mvo()("to", accounts[j])("quantity", asset( 1, sym )) );
+         }
+         base_tester::push_action( N(eosio.token), N(issuemany), config::system_account_name, mvo()
+            ("issues", issues)
+            ("memo", "")
+         );
+      }
+      m.ram_delta = total_ram_usage() - ram_before;
+      return m;
+   };
+
+   const auto label = std::to_string( holders ) + "_holders";
+   const auto full    = balance_rows( symbol( 8, "FULL" ), false );
+   const auto compact = balance_rows( symbol( 8, "CMPCT" ), true );
+   record( "eosio.token::accounts/" + label, full );
+   record( "eosio.token::balances/" + label, compact );
+
+   BOOST_TEST_MESSAGE( "RAM per holder: accounts " << double( full.ram_delta ) / holders << " bytes, balances "
+                       << double( compact.ram_delta ) / holders << " bytes; for 1000000 holders: accounts "
+                       << int64_t( full.ram_delta * ( 1000000.0 / holders ) ) << " bytes, balances "
+                       << int64_t( compact.ram_delta * ( 1000000.0 / holders ) ) << " bytes" );
+   BOOST_REQUIRE( compact.ram_delta < full.ram_delta );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( bandwidth_actions, benchmark_tester ) try {
+   const auto stake = asset( 1000000000, core );
+   transfer( config::system_account_name, N(alice1111111), stake + stake );
+   produce_block();
+
+   measure( "eosio::delegatebw", config::system_account_name, N(delegatebw), config::system_account_name, mvo()
+      ("from", "eosio")
+      ("receiver", "alice1111111")
+      ("stake_net_quantity", stake)
+      ("stake_cpu_quantity", stake)
+      ("transfer", false)
+   );
+   measure( "eosio::undelegatebw", config::system_account_name, N(undelegatebw), config::system_account_name, mvo()
+      ("from", "eosio")
+      ("receiver", "alice1111111")
+      ("unstake_net_quantity", stake)
+      ("unstake_cpu_quantity", stake)
+   );
+   measure( "eosio::delegatebw/transfer", config::system_account_name, N(delegatebw), config::system_account_name, mvo()
+      ("from", "eosio")
+      ("receiver", "bob111111111")
+      ("stake_net_quantity", stake)
+      ("stake_cpu_quantity", stake)
+      ("transfer", true)
+   );
+   measure( "eosio::delegatebw/self", config::system_account_name, N(delegatebw), N(alice1111111), mvo()
+      ("from", "alice1111111")
+      ("receiver", "alice1111111")
+      ("stake_net_quantity", stake)
+      ("stake_cpu_quantity", stake)
+      ("transfer", false)
+   );
+   // the refund delay is 0, so the tokens are transferred back by the same transaction
+   measure( "eosio::undelegatebw/self", config::system_account_name, N(undelegatebw), N(alice1111111), mvo()
+      ("from", "alice1111111")
+      ("receiver", "alice1111111")
+      ("unstake_net_quantity", stake)
+      ("unstake_cpu_quantity", stake)
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( proxy_actions, benchmark_tester ) try {
+   const auto stake = asset( 1000000000, core );
+   base_tester::push_action( config::system_account_name, N(delegatebw), config::system_account_name, mvo()
+      ("from", "eosio")
+      ("receiver", "alice1111111")
+      ("stake_net_quantity", stake)
+      ("stake_cpu_quantity", stake)
+      ("transfer", false)
+   );
+   produce_block();
+
+   // voting is disabled on this chain, so becoming a proxy is the only way to propagate a vote weight change
+   measure( "eosio::regproxy", config::system_account_name, N(regproxy), config::system_account_name, mvo()
+      ("proxy", "eosio")
+      ("isproxy", true)
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( setacct_actions, benchmark_tester ) try {
+   measure( "eosio::setacctram", { setacct_action( N(setacctram), N(bob111111111), "ram_bytes", 2 * 1024 * 1024 ) }, { config::system_account_name } );
+   measure( "eosio::setacctnet", { setacct_action( N(setacctnet), N(bob111111111), "net_weight", 1000000 ) }, { config::system_account_name } );
+   measure( "eosio::setacctcpu", { setacct_action( N(setacctcpu), N(bob111111111), "cpu_weight", 1000000 ) }, { config::system_account_name } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( setacctres_batch, benchmark_tester ) try {
+   vector<account_name> accounts;
+   for( uint32_t i = 0; i < 1000; ++i ) {
+      accounts.emplace_back( string( "account" ) + char( 'a' + i / 26 / 26 ) + char( 'a' + i / 26 % 26 ) + char( 'a' + i % 26 ) );
+      create_sidechain_account( accounts.back() );
+      if( i % 50 == 49 )
+         produce_block();
+   }
+   produce_blocks();
+
+   auto setacctres = [&]( size_t count, int64_t ram_bytes ) {
+      vector<fc::variant> resources;
+      for( size_t i = 0; i < count; ++i ) {
+         resources.emplace_back( mvo()
+            ("account", accounts[i])
+            ("ram_bytes", ram_bytes)
+            ("net_weight", 1000000)
+            ("cpu_weight", 1000000)
+         );
+      }
+      return get_action( config::system_account_name, N(setacctres), {{config::system_account_name, config::active_name}},
+                         mvo()("accounts", resources) );
+   };
+
+   // the same limits set for 100 accounts one resource at a time, then in one batch
+   vector<action> single;
+   for( size_t i = 0; i < 100; ++i ) {
+      single.emplace_back( setacct_action( N(setacctram), accounts[i], "ram_bytes", 2 * 1024 * 1024 ) );
+      single.emplace_back( setacct_action( N(setacctnet), accounts[i], "net_weight", 1000000 ) );
+      single.emplace_back( setacct_action( N(setacctcpu), accounts[i], "cpu_weight", 1000000 ) );
+   }
+   measure( "eosio::setacctram+net+cpu/100_accounts", std::move( single ), { config::system_account_name } );
+   measure( "eosio::setacctres/100_accounts", { setacctres( 100, 3 * 1024 * 1024 ) }, { config::system_account_name } );
+   measure( "eosio::setacctres/1000_accounts", { setacctres( 1000, 4 * 1024 * 1024 ) }, { config::system_account_name } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( newaccounts_batch, benchmark_tester ) try {
+   vector<fc::variant> accounts;
+   for( uint32_t i = 0; i < 100; ++i ) {
+      const account_name a( string( "newaccount" ) + char( 'a' + i / 26 ) + char( 'a' + i % 26 ) );
+      accounts.emplace_back( mvo()
+         ("account", a)
+         ("owner", authority( get_public_key( a, "owner" ) ))
+         ("active", authority( get_public_key( a, "active" ) ))
+         ("ram_bytes", 1024 * 1024)
+         ("net_weight", -1)
+         ("cpu_weight", -1)
+      );
+   }
+   measure( "eosio::newaccounts/100_accounts", config::system_account_name, N(newaccounts), config::system_account_name, mvo()
+      ("creator", "eosio")
+      ("accounts", accounts)
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( setpriv, benchmark_tester ) try {
+   // leaves the global state untouched
+   measure( "eosio::setpriv", config::system_account_name, N(setpriv), config::system_account_name, mvo()
+      ("account", "bob111111111")
+      ("is_priv", 0)
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( onblock, benchmark_tester ) try {
+   // pushed like any other action; the implicit onblock transaction runs the same code
+   measure( "eosio::onblock", { onblock_action( control->head_block_header().timestamp.next() ) }, { config::system_account_name } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( onblock_schedule_update, benchmark_tester ) try {
+   vector<account_name> producers;
+   for( uint32_t i = 0; i < 500; ++i ) {
+      producers.emplace_back( string( "producer" ) + char( 'a' + i / 26 / 26 ) + char( 'a' + i / 26 % 26 ) + char( 'a' + i % 26 ) );
+   }
+   for( size_t i = 0; i < producers.size(); ++i ) {
+      const auto p = producers[i];
+      create_sidechain_account( p );
+      base_tester::push_action( config::system_account_name, N(regproducer), p, mvo()
+         ("producer", p)
+         ("producer_key", get_public_key( p, "active" ))
+         ("url", "")
+         ("location", 0)
+      );
+      if( i % 50 == 49 )
+         produce_block();
+   }
+   produce_blocks();
+
+   // the elected schedule is recomputed once every 120 slots; the onblock right after only counts the block
+   auto timestamp = control->head_block_header().timestamp.next();
+   measure( "eosio::onblock/500_producers/schedule_update", { onblock_action( timestamp, producers[0] ) }, { config::system_account_name } );
+   measure( "eosio::onblock/500_producers", { onblock_action( timestamp.next(), producers[0] ) }, { config::system_account_name } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( claimrewards, benchmark_tester ) try {
+   // producers are only paid once enough stake voted, which takes the voting build
+   set_code( config::system_account_name, contracts::util::system_voting_wasm() );
+   regproducer( config::system_account_name );
+   const auto stake = asset( 100000000000000ll, core );
+   base_tester::push_action( config::system_account_name, N(delegatebw), config::system_account_name, mvo()
+      ("from", "eosio")
+      ("receiver", "alice1111111")
+      ("stake_net_quantity", stake)
+      ("stake_cpu_quantity", stake)
+      ("transfer", false)
+   );
+   produce_block();
+
+   measure( "eosio::voteproducer", config::system_account_name, N(voteproducer), config::system_account_name, mvo()
+      ("voter", "eosio")
+      ("proxy", name(0))
+      ("producers", vector<account_name>{ config::system_account_name })
+   );
+   produce_block( fc::days(1) );
+   produce_blocks( 10 );
+
+   // folds the blocks counted since the last schedule update, then pays them out of eosio.bpay and eosio.vpay
+   measure( "eosio::claimrewards", config::system_account_name, N(claimrewards), config::system_account_name, mvo()
+      ("owner", "eosio")
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( msig_actions, benchmark_tester ) try {
+   transaction trx;
+   set_transaction_headers( trx );
+   trx.actions.emplace_back( vector<permission_level>{{N(alice1111111), config::active_name}},
+                             config::system_account_name, N(reqauth), fc::raw::pack( N(alice1111111) ) );
+
+   measure( "eosio.msig::propose", N(eosio.msig), N(propose), N(alice1111111), mvo()
+      ("proposer", "alice1111111")
+      ("proposal_name", "first")
+      ("trx", trx)
+      ("requested", vector<permission_level>{{ N(alice1111111), config::active_name }})
+   );
+   measure( "eosio.msig::approve", N(eosio.msig), N(approve), N(alice1111111), mvo()
+      ("proposer", "alice1111111")
+      ("proposal_name", "first")
+      ("level", permission_level{ N(alice1111111), config::active_name })
+   );
+   measure( "eosio.msig::exec", N(eosio.msig), N(exec), N(alice1111111), mvo()
+      ("proposer", "alice1111111")
+      ("proposal_name", "first")
+      ("executer", "alice1111111")
+   );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( wrap_actions, benchmark_tester ) try {
+   transaction trx;
+   set_transaction_headers( trx );
+   trx.actions.emplace_back( vector<permission_level>{{N(bob111111111), config::active_name}},
+                             config::system_account_name, N(reqauth), fc::raw::pack( N(bob111111111) ) );
+
+   measure( "eosio.wrap::exec",
+            { get_action( N(eosio.wrap), N(exec), {{N(alice1111111), config::active_name}, {N(eosio.wrap), config::active_name}}, mvo()
+                 ("executer", "alice1111111")
+                 ("trx", trx)
+            ) },
+            { N(alice1111111), N(eosio.wrap) } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
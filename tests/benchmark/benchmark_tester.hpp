@@ -0,0 +1,179 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/block_header.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <fc/io/json.hpp>
+
+#include "../eosio.system_tester.hpp"
+
+#include <cstdlib>
+#include <map>
+
+namespace eosio_benchmark {
+
+using namespace eosio_system;
+
+/// cost of one benchmarked transaction
+struct measurement {
+   int64_t elapsed_us = 0;  ///< wall time of all action traces, inline actions included
+   int64_t cpu_usage  = 0;  ///< billed CPU microseconds of the transaction
+   int64_t net_usage  = 0;  ///< billed NET bytes of the transaction
+   int64_t ram_delta  = 0;  ///< change of the RAM usage summed over all accounts
+};
+
+} /// namespace eosio_benchmark
+
+FC_REFLECT( eosio_benchmark::measurement, (elapsed_us)(cpu_usage)(net_usage)(ram_delta) )
+
+namespace eosio_benchmark {
+
+/// measurements of this run by label, written to $BENCHMARK_OUTPUT at exit
+inline std::map<std::string, measurement>& results() {
+   static std::map<std::string, measurement> r;
+   return r;
+}
+
+/// measurements of the reference run by label, read from $BENCHMARK_BASELINE or the checked in baseline.json
+inline const fc::variant_object& baseline() {
+   static fc::variant_object b = [] {
+      const char* path = std::getenv( "BENCHMARK_BASELINE" );
+      auto v = fc::json::from_file( path ? path : BENCHMARK_BASELINE_FILE );
+      return v.is_object() ? v.get_object() : fc::variant_object();
+   }();
+   return b;
+}
+
+/// allowed increase of net_usage and ram_delta over the baseline in percent, $BENCHMARK_THRESHOLD or 0
+inline double threshold() {
+   const char* t = std::getenv( "BENCHMARK_THRESHOLD" );
+   return t ? std::atof( t ) : 0.0;
+}
+
+/// allowed increase of elapsed_us and cpu_usage over the baseline in percent, $BENCHMARK_TIME_THRESHOLD,
+/// negative (the timings are only reported) when it is not set
+inline double time_threshold() {
+   const char* t = std::getenv( "BENCHMARK_TIME_THRESHOLD" );
+   return t ? std::atof( t ) : -1.0;
+}
+
+/**
+ *  System tester for a sidechain configured the way it is run: an 8 decimal core token, accounts
+ *  created by eosio with their resources set through setacctram/setacctnet/setacctcpu, and the
+ *  msig and wrap contracts deployed next to eosio.system.
+ */
+class benchmark_tester : public eosio_system_tester {
+public:
+   const symbol core = symbol( 8, "TST" );
+
+   benchmark_tester() : eosio_system_tester( setup_level::minimal ) {
+      init_sidechain( core );
+      produce_blocks();
+
+      for( auto a : { N(alice1111111), N(bob111111111), N(carol1111111), N(eosio.msig), N(eosio.wrap) } ) {
+         create_sidechain_account( a );
+      }
+      for( auto a : { N(eosio.msig), N(eosio.wrap) } ) {
+         base_tester::push_action( config::system_account_name, N(setpriv), config::system_account_name, mvo()
+            ("account", a)
+            ("is_priv", 1)
+         );
+      }
+      set_code( N(eosio.msig), contracts::msig_wasm() );
+      set_abi( N(eosio.msig), contracts::msig_abi().data() );
+      set_code( N(eosio.wrap), contracts::wrap_wasm() );
+      set_abi( N(eosio.wrap), contracts::wrap_abi().data() );
+      produce_blocks();
+   }
+
+   action onblock_action( block_timestamp_type timestamp, account_name producer = config::system_account_name ) {
+      block_header header;
+      header.timestamp = timestamp;
+      header.producer  = producer;
+      return action( vector<permission_level>{{config::system_account_name, config::active_name}},
+                     config::system_account_name, N(onblock), fc::raw::pack( header ) );
+   }
+
+   int64_t total_ram_usage() {
+      const auto& rlm = control->get_resource_limits_manager();
+      int64_t total = 0;
+      for( const auto& a : control->db().get_index<account_index, by_name>() ) {
+         total += rlm.get_account_ram_usage( a.name );
+      }
+      return total;
+   }
+
+   static int64_t elapsed_us( const vector<action_trace>& traces ) {
+      int64_t total = 0;
+      for( const auto& at : traces ) {
+         total += at.elapsed.count() + elapsed_us( at.inline_traces );
+      }
+      return total;
+   }
+
+   /**
+    *  Pushes `actions` signed by `signers` in their own transaction, records its cost under
+    *  `label` and checks it against the baseline.
+    */
+   measurement measure( const string& label, vector<action> actions, const vector<account_name>& signers ) {
+      signed_transaction trx;
+      trx.actions = std::move( actions );
+      set_transaction_headers( trx );
+      for( const auto& s : signers ) {
+         trx.sign( get_private_key( s, "active" ), control->get_chain_id() );
+      }
+
+      const auto ram_before = total_ram_usage();
+      auto trace = push_transaction( trx );
+
+      measurement m;
+      m.elapsed_us = elapsed_us( trace->action_traces );
+      m.cpu_usage  = trace->receipt->cpu_usage_us;
+      m.net_usage  = trace->net_usage;
+      m.ram_delta  = total_ram_usage() - ram_before;
+      produce_block();
+
+      record( label, m );
+      return m;
+   }
+
+   measurement measure( const string& label, account_name code, action_name name, account_name signer, const variant_object& data ) {
+      return measure( label, { get_action( code, name, {{signer, config::active_name}}, data ) }, { signer } );
+   }
+
+   static void record( const string& label, const measurement& m ) {
+      BOOST_TEST_MESSAGE( label << ": elapsed " << m.elapsed_us << " us, cpu " << m.cpu_usage << " us, net " << m.net_usage << " bytes, ram " << m.ram_delta << " bytes" );
+      results()[label] = m;
+
+      auto itr = baseline().find( label );
+      if( itr == baseline().end() ) {
+         BOOST_TEST_MESSAGE( label << ": no baseline" );
+         return;
+      }
+      measurement base;
+      fc::from_variant( itr->value(), base );
+
+      auto check = [&]( const char* metric, int64_t current, int64_t reference, double percent ) {
+         const double limit = reference + std::abs( reference ) * percent / 100;
+         BOOST_CHECK_MESSAGE( current <= limit, label << " " << metric << " regressed: " << current << " > " << reference
+                                                << " + " << percent << "%" );
+      };
+      // NET and RAM only depend on the contract code and the transaction, so they gate every run
+      check( "net_usage",  m.net_usage,  base.net_usage,  threshold() );
+      check( "ram_delta",  m.ram_delta,  base.ram_delta,  threshold() );
+
+      // timings depend on the machine and its load, they only gate runs that ask for it
+      if( time_threshold() < 0 ) {
+         BOOST_TEST_MESSAGE( label << ": baseline elapsed " << base.elapsed_us << " us, cpu " << base.cpu_usage << " us" );
+         return;
+      }
+      check( "elapsed_us", m.elapsed_us, base.elapsed_us, time_threshold() );
+      check( "cpu_usage",  m.cpu_usage,  base.cpu_usage,  time_threshold() );
+   }
+};
+
+} /// namespace eosio_benchmark
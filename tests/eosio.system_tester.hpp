@@ -121,6 +121,49 @@ public:
    }
 
 
+   /// sets up the contracts the way the sidechain runs them: a core token with 8 decimals and an initialized system contract
+   void init_sidechain( const symbol& core ) {
+      create_currency( N(eosio.token), config::system_account_name, asset( 100000000000000000ll, core ) );
+      issue( config::system_account_name, asset( 10000000000000000ll, core ) );
+
+      deploy_contract( false );
+      base_tester::push_action( config::system_account_name, N(init), config::system_account_name, mvo()
+         ("version", 0)
+         ("core", core)
+      );
+      // eosio.token sets the RAM limit of accounts that follow their RAM token balance
+      base_tester::push_action( config::system_account_name, N(setpriv), config::system_account_name, mvo()
+         ("account", "eosio.token")
+         ("is_priv", 1)
+      );
+   }
+
+   /// sidechain accounts are created by eosio, which sets their resources in the same transaction
+   transaction_trace_ptr create_sidechain_account( account_name a, int64_t ram_bytes = 1024 * 1024 ) {
+      signed_transaction trx;
+      set_transaction_headers( trx );
+
+      trx.actions.emplace_back( vector<permission_level>{{config::system_account_name, config::active_name}},
+                                newaccount{
+                                   .creator  = config::system_account_name,
+                                   .name     = a,
+                                   .owner    = authority( get_public_key( a, "owner" ) ),
+                                   .active   = authority( get_public_key( a, "active" ) )
+                                });
+      trx.actions.emplace_back( setacct_action( N(setacctram), a, "ram_bytes", ram_bytes ) );
+      trx.actions.emplace_back( setacct_action( N(setacctnet), a, "net_weight", -1 ) );
+      trx.actions.emplace_back( setacct_action( N(setacctcpu), a, "cpu_weight", -1 ) );
+
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( config::system_account_name, "active" ), control->get_chain_id() );
+      return push_transaction( trx );
+   }
+
+   action setacct_action( action_name name, account_name a, const string& field, int64_t value ) {
+      return get_action( config::system_account_name, name, vector<permission_level>{{config::system_account_name, config::active_name}},
+                         mvo()("account", a)(field, value) );
+   }
+
    void create_accounts_with_resources( vector<account_name> accounts, account_name creator = config::system_account_name ) {
       for( auto a : accounts ) {
          create_account_with_resources( a, creator );
@@ -366,7 +409,11 @@ public:
    }
 
    asset get_balance( const account_name& act, symbol balance_symbol = symbol{CORE_SYM} ) {
-      vector<char> data = get_row_by_account( N(eosio.token), act, N(accounts), balance_symbol.to_symbol_code().value );
+      vector<char> data = get_row_by_account( N(eosio.token), act, N(balances), balance_symbol.to_symbol_code().value );
+      if( !data.empty() ) {
+         return asset( token_abi_ser.binary_to_variant("compact_account", data, abi_serializer_max_time)["amount"].as<int64_t>(), balance_symbol );
+      }
+      data = get_row_by_account( N(eosio.token), act, N(accounts), balance_symbol.to_symbol_code().value );
       return data.empty() ? asset(0, balance_symbol) : token_abi_ser.binary_to_variant("account", data, abi_serializer_max_time)["balance"].as<asset>();
    }
 
@@ -380,11 +427,40 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "voter_info", data, abi_serializer_max_time );
    }
 
+   /// blocks counted by onblock that are not folded into the producer rows yet
+   std::map<account_name, uint32_t> get_pending_unpaid_blocks() {
+      std::map<account_name, uint32_t> pending;
+      const auto& db = control->db();
+      const auto* tbl = db.find<table_id_object, by_code_scope_table>(
+         boost::make_tuple( config::system_account_name, config::system_account_name, N(unpaidblocks) ) );
+      if( !tbl ) return pending;
+      const auto& idx = db.get_index<key_value_index, by_scope_primary>();
+      for( auto itr = idx.lower_bound( boost::make_tuple( tbl->id ) ); itr != idx.end() && itr->t_id == tbl->id; ++itr ) {
+         vector<char> data( itr->value.data(), itr->value.data() + itr->value.size() );
+         auto c = abi_ser.binary_to_variant( "producer_block_count", data, abi_serializer_max_time );
+         pending[ c["producer"].as<account_name>() ] = c["blocks"].as<uint32_t>();
+      }
+      return pending;
+   }
+
    fc::variant get_producer_info( const account_name& act ) {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(producers), act );
       return abi_ser.binary_to_variant( "producer_info", data, abi_serializer_max_time );
    }
 
+   /// blocks of the producer not paid yet, folded into its row or still pending
+   uint32_t get_unpaid_blocks( const account_name& act ) {
+      return get_producer_info( act )["unpaid_blocks"].as<uint32_t>() + get_pending_unpaid_blocks()[act];
+   }
+
+   uint32_t get_total_unpaid_blocks() {
+      uint32_t total = get_global_state()["total_unpaid_blocks"].as<uint32_t>();
+      for( const auto& p : get_pending_unpaid_blocks() ) {
+         total += p.second;
+      }
+      return total;
+   }
+
    fc::variant get_producer_info2( const account_name& act ) {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(producers2), act );
       return abi_ser.binary_to_variant( "producer_info2", data, abi_serializer_max_time );
@@ -1,5 +1,6 @@
 #include <boost/test/unit_test.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
@@ -10,6 +11,8 @@
 #include <eosio/chain/exceptions.hpp>
 #include <Runtime/Runtime.h>
 
+#include <eosio.system/bancor.hpp>
+
 #include "eosio.system_tester.hpp"
 struct _abi_hash {
    name owner;
@@ -1225,10 +1228,10 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
       const int64_t  initial_savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = get_total_unpaid_blocks();
 
       prod = get_producer_info("defproducera");
-      const uint32_t unpaid_blocks = prod["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks = get_unpaid_blocks(N(defproducera));
       BOOST_REQUIRE(1 < unpaid_blocks);
 
       BOOST_REQUIRE_EQUAL(initial_tot_unpaid_blocks, unpaid_blocks);
@@ -1243,10 +1246,10 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
       const int64_t  savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = get_total_unpaid_blocks();
 
       prod = get_producer_info("defproducera");
-      BOOST_REQUIRE_EQUAL(1, prod["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(1, get_unpaid_blocks(N(defproducera)));
       BOOST_REQUIRE_EQUAL(1, tot_unpaid_blocks);
       const asset supply  = get_token_supply();
       const asset balance = get_balance(N(defproducera));
@@ -1301,11 +1304,11 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
       const int64_t  initial_savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = get_total_unpaid_blocks();
       const double   initial_tot_vote_weight   = initial_global_state["total_producer_vote_weight"].as<double>();
 
       prod = get_producer_info("defproducera");
-      const uint32_t unpaid_blocks = prod["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks = get_unpaid_blocks(N(defproducera));
       BOOST_REQUIRE(1 < unpaid_blocks);
       BOOST_REQUIRE_EQUAL(initial_tot_unpaid_blocks, unpaid_blocks);
       BOOST_REQUIRE(0 < prod["total_votes"].as<double>());
@@ -1324,10 +1327,10 @@ BOOST_FIXTURE_TEST_CASE(producer_pay, eosio_system_tester, * boost::unit_test::t
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
       const int64_t  savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = get_total_unpaid_blocks();
 
       prod = get_producer_info("defproducera");
-      BOOST_REQUIRE_EQUAL(1, prod["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(1, get_unpaid_blocks(N(defproducera)));
       BOOST_REQUIRE_EQUAL(1, tot_unpaid_blocks);
       const asset supply  = get_token_supply();
       const asset balance = get_balance(N(defproducera));
@@ -1448,7 +1451,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       auto prodv = get_producer_info( N(defproducerv) );
       auto prodz = get_producer_info( N(defproducerz) );
 
-      BOOST_REQUIRE (0 == proda["unpaid_blocks"].as<uint32_t>() && 0 == prodz["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE (0 == get_unpaid_blocks(N(defproducera)) && 0 == get_unpaid_blocks(N(defproducerz)));
 
       // check vote ratios
       BOOST_REQUIRE ( 0 < proda["total_votes"].as<double>() && 0 < prodz["total_votes"].as<double>() );
@@ -1464,13 +1467,13 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       produce_blocks(23 * 12 + 20);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_unpaid_blocks(producer_names[i])) {
             all_21_produced = false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_unpaid_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -1501,12 +1504,12 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
       const int64_t  initial_savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = get_total_unpaid_blocks();
       const asset    initial_supply            = get_token_supply();
       const asset    initial_bpay_balance      = get_balance(N(eosio.bpay));
       const asset    initial_vpay_balance      = get_balance(N(eosio.vpay));
       const asset    initial_balance           = get_balance(prod_name);
-      const uint32_t initial_unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_unpaid_blocks     = get_unpaid_blocks(prod_name);
 
       BOOST_REQUIRE_EQUAL(success(), push_action(prod_name, N(claimrewards), mvo()("owner", prod_name)));
 
@@ -1515,12 +1518,12 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
       const int64_t  savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = get_total_unpaid_blocks();
       const asset    supply            = get_token_supply();
       const asset    bpay_balance      = get_balance(N(eosio.bpay));
       const asset    vpay_balance      = get_balance(N(eosio.vpay));
       const asset    balance           = get_balance(prod_name);
-      const uint32_t unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks     = get_unpaid_blocks(prod_name);
 
       const uint64_t usecs_between_fills = claim_time - initial_claim_time;
       const int32_t secs_between_fills = static_cast<int32_t>(usecs_between_fills / 1000000);
@@ -1577,12 +1580,12 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
       const int64_t  initial_savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = get_total_unpaid_blocks();
       const asset    initial_supply            = get_token_supply();
       const asset    initial_bpay_balance      = get_balance(N(eosio.bpay));
       const asset    initial_vpay_balance      = get_balance(N(eosio.vpay));
       const asset    initial_balance           = get_balance(prod_name);
-      const uint32_t initial_unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_unpaid_blocks     = get_unpaid_blocks(prod_name);
 
       BOOST_REQUIRE_EQUAL(success(), push_action(prod_name, N(claimrewards), mvo()("owner", prod_name)));
 
@@ -1591,12 +1594,12 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
       const int64_t  savings           = get_balance(N(eosio.saving)).get_amount();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = get_total_unpaid_blocks();
       const asset    supply            = get_token_supply();
       const asset    bpay_balance      = get_balance(N(eosio.bpay));
       const asset    vpay_balance      = get_balance(N(eosio.vpay));
       const asset    balance           = get_balance(prod_name);
-      const uint32_t unpaid_blocks     = get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks     = get_unpaid_blocks(prod_name);
 
       const uint64_t usecs_between_fills = claim_time - initial_claim_time;
 
@@ -1656,7 +1659,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       {
          bool rest_didnt_produce = true;
          for (uint32_t i = 21; i < producer_names.size(); ++i) {
-            if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+            if (0 < get_unpaid_blocks(producer_names[i])) {
                rest_didnt_produce = false;
             }
          }
@@ -1665,17 +1668,17 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
 
       produce_blocks(3 * 21 * 12);
       info = get_producer_info(prod_name);
-      const uint32_t init_unpaid_blocks = info["unpaid_blocks"].as<uint32_t>();
+      const uint32_t init_unpaid_blocks = get_unpaid_blocks(prod_name);
       BOOST_REQUIRE( !info["is_active"].as<bool>() );
       BOOST_REQUIRE( fc::crypto::public_key() == fc::crypto::public_key(info["producer_key"].as_string()) );
       BOOST_REQUIRE_EQUAL( wasm_assert_msg("producer does not have an active key"),
                            push_action(prod_name, N(claimrewards), mvo()("owner", prod_name) ) );
       produce_blocks(3 * 21 * 12);
-      BOOST_REQUIRE_EQUAL( init_unpaid_blocks, get_producer_info(prod_name)["unpaid_blocks"].as<uint32_t>() );
+      BOOST_REQUIRE_EQUAL( init_unpaid_blocks, get_unpaid_blocks(prod_name) );
       {
          bool prod_was_replaced = false;
          for (uint32_t i = 21; i < producer_names.size(); ++i) {
-            if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+            if (0 < get_unpaid_blocks(producer_names[i])) {
                prod_was_replaced = true;
             }
          }
@@ -1711,10 +1714,10 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const uint64_t initial_bucket_fill_time  = microseconds_since_epoch_of_iso_string( initial_global_state["last_pervote_bucket_fill"] );
       const int64_t  initial_pervote_bucket    = initial_global_state["pervote_bucket"].as<int64_t>();
       const int64_t  initial_perblock_bucket   = initial_global_state["perblock_bucket"].as<int64_t>();
-      const uint32_t initial_tot_unpaid_blocks = initial_global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_tot_unpaid_blocks = get_total_unpaid_blocks();
       const asset    initial_supply            = get_token_supply();
       const asset    initial_balance           = get_balance(prod_name);
-      const uint32_t initial_unpaid_blocks     = initial_prod_info["unpaid_blocks"].as<uint32_t>();
+      const uint32_t initial_unpaid_blocks     = get_unpaid_blocks(prod_name);
       const uint64_t initial_claim_time        = microseconds_since_epoch_of_iso_string( initial_prod_info["last_claim_time"] );
       const uint64_t initial_prod_update_time  = microseconds_since_epoch_of_iso_string( initial_prod_info2["last_votepay_share_update"] );
 
@@ -1728,10 +1731,10 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_pay, eosio_system_tester, * boost::uni
       const uint64_t bucket_fill_time  = microseconds_since_epoch_of_iso_string( global_state["last_pervote_bucket_fill"] );
       const int64_t  pervote_bucket    = global_state["pervote_bucket"].as<int64_t>();
       const int64_t  perblock_bucket   = global_state["perblock_bucket"].as<int64_t>();
-      const uint32_t tot_unpaid_blocks = global_state["total_unpaid_blocks"].as<uint32_t>();
+      const uint32_t tot_unpaid_blocks = get_total_unpaid_blocks();
       const asset    supply            = get_token_supply();
       const asset    balance           = get_balance(prod_name);
-      const uint32_t unpaid_blocks     = prod_info["unpaid_blocks"].as<uint32_t>();
+      const uint32_t unpaid_blocks     = get_unpaid_blocks(prod_name);
       const uint64_t claim_time        = microseconds_since_epoch_of_iso_string( prod_info["last_claim_time"] );
       const uint64_t prod_update_time  = microseconds_since_epoch_of_iso_string( prod_info2["last_votepay_share_update"] );
 
@@ -1842,7 +1845,7 @@ BOOST_FIXTURE_TEST_CASE(multiple_producer_votepay_share, eosio_system_tester, *
       auto prodv = get_producer_info( N(defproducerv) );
       auto prodz = get_producer_info( N(defproducerz) );
 
-      BOOST_REQUIRE (0 == proda["unpaid_blocks"].as<uint32_t>() && 0 == prodz["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE (0 == get_unpaid_blocks(N(defproducera)) && 0 == get_unpaid_blocks(N(defproducerz)));
 
       // check vote ratios
       BOOST_REQUIRE ( 0 < proda["total_votes"].as_double() && 0 < prodz["total_votes"].as_double() );
@@ -2492,13 +2495,13 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
       produce_blocks(21 * 12);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_unpaid_blocks(producer_names[i])) {
             all_21_produced= false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_unpaid_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -2508,7 +2511,7 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
 
    {
       const char* claimrewards_activation_error_message = "cannot claim rewards until the chain is activated (at least 15% of all tokens participate in voting)";
-      BOOST_CHECK_EQUAL(0, get_global_state()["total_unpaid_blocks"].as<uint32_t>());
+      BOOST_CHECK_EQUAL(0, get_total_unpaid_blocks());
       BOOST_REQUIRE_EQUAL(wasm_assert_msg( claimrewards_activation_error_message ),
                           push_action(producer_names.front(), N(claimrewards), mvo()("owner", producer_names.front())));
       BOOST_REQUIRE_EQUAL(0, get_balance(producer_names.front()).get_amount());
@@ -2531,13 +2534,13 @@ BOOST_FIXTURE_TEST_CASE(producer_onblock_check, eosio_system_tester) try {
       produce_blocks(21 * 12);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_unpaid_blocks(producer_names[i])) {
             all_21_produced= false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_unpaid_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -2970,7 +2973,7 @@ BOOST_FIXTURE_TEST_CASE( multiple_namebids, eosio_system_tester ) try {
 
    // stake enough to go above the 15% threshold
    stake_with_transfer( config::system_account_name, "alice", core_sym::from_string( "10000000.0000" ), core_sym::from_string( "10000000.0000" ) );
-   BOOST_REQUIRE_EQUAL(0, get_producer_info("producer")["unpaid_blocks"].as<uint32_t>());
+   BOOST_REQUIRE_EQUAL(0, get_unpaid_blocks("producer"));
    BOOST_REQUIRE_EQUAL( success(), vote( N(alice), { N(producer) } ) );
 
    // need to wait for 14 days after going live
@@ -3093,13 +3096,13 @@ BOOST_FIXTURE_TEST_CASE( vote_producers_in_and_out, eosio_system_tester ) try {
       produce_blocks(23 * 12 + 20);
       bool all_21_produced = true;
       for (uint32_t i = 0; i < 21; ++i) {
-         if (0 == get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 == get_unpaid_blocks(producer_names[i])) {
             all_21_produced = false;
          }
       }
       bool rest_didnt_produce = true;
       for (uint32_t i = 21; i < producer_names.size(); ++i) {
-         if (0 < get_producer_info(producer_names[i])["unpaid_blocks"].as<uint32_t>()) {
+         if (0 < get_unpaid_blocks(producer_names[i])) {
             rest_didnt_produce = false;
          }
       }
@@ -3112,12 +3115,12 @@ BOOST_FIXTURE_TEST_CASE( vote_producers_in_and_out, eosio_system_tester ) try {
       const uint32_t new_prod_index  = 23;
       BOOST_REQUIRE_EQUAL(success(), stake("producvoterd", core_sym::from_string("40000000.0000"), core_sym::from_string("40000000.0000")));
       BOOST_REQUIRE_EQUAL(success(), vote(N(producvoterd), { producer_names[new_prod_index] }));
-      BOOST_REQUIRE_EQUAL(0, get_producer_info(producer_names[new_prod_index])["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(0, get_unpaid_blocks(producer_names[new_prod_index]));
       produce_blocks(4 * 12 * 21);
-      BOOST_REQUIRE(0 < get_producer_info(producer_names[new_prod_index])["unpaid_blocks"].as<uint32_t>());
-      const uint32_t initial_unpaid_blocks = get_producer_info(producer_names[voted_out_index])["unpaid_blocks"].as<uint32_t>();
+      BOOST_REQUIRE(0 < get_unpaid_blocks(producer_names[new_prod_index]));
+      const uint32_t initial_unpaid_blocks = get_unpaid_blocks(producer_names[voted_out_index]);
       produce_blocks(2 * 12 * 21);
-      BOOST_REQUIRE_EQUAL(initial_unpaid_blocks, get_producer_info(producer_names[voted_out_index])["unpaid_blocks"].as<uint32_t>());
+      BOOST_REQUIRE_EQUAL(initial_unpaid_blocks, get_unpaid_blocks(producer_names[voted_out_index]));
       produce_block(fc::hours(24));
       BOOST_REQUIRE_EQUAL(success(), vote(N(producvoterd), { producer_names[voted_out_index] }));
       produce_blocks(2 * 12 * 21);
@@ -3524,6 +3527,79 @@ BOOST_FIXTURE_TEST_CASE( change_limited_account_back_to_unlimited, eosio_system_
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( setacctram_mirrors_ram_managed_to_token, eosio_system_tester ) try {
+   // eosio.token needs the privilege to set the RAM limit of unmanaged accounts
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio), N(setpriv), mvo()
+                                                ("account", "eosio.token")
+                                                ("is_priv", 1) ) );
+   const asset ram_supply = asset::from_string("1000000.00000000 RAM");
+   create_currency( N(eosio.token), config::system_account_name, ram_supply );
+   issue( config::system_account_name, ram_supply );
+   transfer( config::system_account_name, N(alice1111111), asset::from_string("10.00000000 RAM"), config::system_account_name );
+
+   auto get_ram_managed = [&]( account_name acc ) {
+      vector<char> data = get_row_by_account( N(eosio.token), N(eosio.token), N(rammanaged), acc );
+      return data.empty() ? fc::variant() : token_abi_ser.binary_to_variant( "ram_managed_account", data, abi_serializer_max_time );
+   };
+   auto get_ram_limit = [&]( account_name acc ) {
+      int64_t ram_bytes = 0, net = 0, cpu = 0;
+      control->get_resource_limits_manager().get_account_limits( acc, ram_bytes, net, cpu );
+      return ram_bytes;
+   };
+
+   BOOST_REQUIRE( get_ram_managed( N(alice1111111) ).is_null() );
+
+   // managed is the default, only unmanaged accounts get a mirror row
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio), N(setacctram), mvo()
+                                                ("account", "alice1111111")
+                                                ("ram_bytes", 5000) ) );
+   BOOST_REQUIRE( get_ram_managed( N(alice1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( 5000, get_ram_limit( N(alice1111111) ) );
+
+   // managed accounts keep their limit when RAM tokens move
+   transfer( config::system_account_name, N(alice1111111), asset::from_string("1.00000000 RAM"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( 5000, get_ram_limit( N(alice1111111) ) );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio), N(setacctram), mvo()
+                                                ("account", "alice1111111")
+                                                ("ram_bytes", fc::variant()) ) );
+   BOOST_REQUIRE_EQUAL( false, get_ram_managed( N(alice1111111) )["managed"].as_bool() );
+   BOOST_REQUIRE_EQUAL( 11000, get_ram_limit( N(alice1111111) ) );
+
+   // unmanaged accounts follow their RAM token balance
+   transfer( config::system_account_name, N(alice1111111), asset::from_string("2.00000000 RAM"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( 13000, get_ram_limit( N(alice1111111) ) );
+
+   // amounts below one byte leave the limit untouched
+   transfer( config::system_account_name, N(alice1111111), asset::from_string("0.00000001 RAM"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( 13000, get_ram_limit( N(alice1111111) ) );
+
+   // unless the limit was set by other means, the next balance change corrects it
+   {
+      int64_t ram_bytes = 0, net = 0, cpu = 0;
+      control->get_resource_limits_manager().get_account_limits( N(alice1111111), ram_bytes, net, cpu );
+      control->get_mutable_resource_limits_manager().set_account_limits( N(alice1111111), 20000, net, cpu );
+   }
+   produce_block();
+   transfer( config::system_account_name, N(alice1111111), asset::from_string("0.00000001 RAM"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( 13000, get_ram_limit( N(alice1111111) ) );
+
+   // mirrorram restores a mirror that is out of sync with the voters table
+   base_tester::push_action( N(eosio.token), N(setrammanage), config::system_account_name, mvo()
+                             ("account", "alice1111111")
+                             ("managed", true) );
+   BOOST_REQUIRE( get_ram_managed( N(alice1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(eosio), N(mirrorram), mvo()
+                                                ("accounts", vector<account_name>{ N(alice1111111), N(bob111111111) }) ) );
+   BOOST_REQUIRE_EQUAL( false, get_ram_managed( N(alice1111111) )["managed"].as_bool() );
+   BOOST_REQUIRE( get_ram_managed( N(bob111111111) ).is_null() );
+
+   BOOST_REQUIRE_THROW( base_tester::push_action( N(eosio.token), N(setrammanage), N(alice1111111), mvo()
+                                                  ("account", "alice1111111")
+                                                  ("managed", true) ),
+                        missing_auth_exception );
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( buy_pin_sell_ram, eosio_system_tester ) try {
    BOOST_REQUIRE( get_total_stake( "eosio" ).is_null() );
 
@@ -3584,4 +3660,533 @@ BOOST_FIXTURE_TEST_CASE( buy_pin_sell_ram, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE( global_state_loaded_on_demand ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol core( 8, "TST" );
+
+   // the contract deployed but not initialized yet, init is the first action that reads the global state
+   t.create_currency( N(eosio.token), config::system_account_name, asset( 100000000000000000ll, core ) );
+   t.issue( config::system_account_name, asset( 10000000000000000ll, core ) );
+   t.deploy_contract( false );
+   t.produce_blocks();
+
+   auto find_table = [&]( table_name table ) {
+      return t.control->db().find<eosio::chain::table_id_object, eosio::chain::by_code_scope_table>(
+                boost::make_tuple( config::system_account_name, config::system_account_name, table ) );
+   };
+
+   t.create_sidechain_account( N(alice1111111) );
+
+   t.set_abi( N(alice1111111), contracts::token_abi().data() );
+   t.produce_blocks();
+
+   // newaccount, setacct* and setabi never read the global state
+   BOOST_REQUIRE( !find_table( N(global) ) );
+   BOOST_REQUIRE( !find_table( N(global2) ) );
+   BOOST_REQUIRE( !find_table( N(global3) ) );
+
+   // updtrevision reads global2 only
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(updtrevision), mvo()("revision", 1) ) );
+   BOOST_REQUIRE( !find_table( N(global) ) );
+   BOOST_REQUIRE( find_table( N(global2) ) );
+   BOOST_REQUIRE( !find_table( N(global3) ) );
+   BOOST_REQUIRE_EQUAL( 1, t.get_global_state2()["revision"].as_int64() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( global3_created_on_demand_after_upgrade ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol old_core( 4, "SYS" ); // core symbol of contracts::util::system_wasm_old()
+
+   auto find_table = [&]( table_name table ) {
+      return t.control->db().find<eosio::chain::table_id_object, eosio::chain::by_code_scope_table>(
+                boost::make_tuple( config::system_account_name, config::system_account_name, table ) );
+   };
+
+   // the contract from before global3 writes global and global2 in every action
+   t.create_currency( N(eosio.token), config::system_account_name, asset( 100000000000000ll, old_core ) );
+   t.issue( config::system_account_name, asset( 10000000000000ll, old_core ) );
+   t.set_code( config::system_account_name, contracts::util::system_wasm_old() );
+   t.set_abi( config::system_account_name, contracts::util::system_abi_old().data() );
+   t.base_tester::push_action( config::system_account_name, N(setpriv), config::system_account_name, mvo()
+      ("account", "eosio.token")
+      ("is_priv", 1)
+   );
+   t.produce_blocks();
+   BOOST_REQUIRE( find_table( N(global) ) );
+   BOOST_REQUIRE( find_table( N(global2) ) );
+   BOOST_REQUIRE( !find_table( N(global3) ) );
+
+   // after the upgrade global3 is only created by an action that reads it
+   t.deploy_contract( false );
+   t.produce_blocks();
+
+   t.create_sidechain_account( N(alice1111111) );
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(updtrevision), mvo()("revision", 1) ) );
+   BOOST_REQUIRE( !find_table( N(global3) ) );
+
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(setrefdelay), mvo()("delay_sec", 0) ) );
+   BOOST_REQUIRE( find_table( N(global3) ) );
+   BOOST_REQUIRE_EQUAL( 0, t.get_global_state3()["refund_delay_sec"].as_int64() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( vote_decay_multiplier_weekly ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol core( 8, "TST" );
+
+   t.init_sidechain( core );
+   t.create_sidechain_account( N(alice1111111) );
+
+   const asset stake( 1234567890123ll, core );
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(delegatebw), mvo()
+                                                       ("from", "eosio")
+                                                       ("receiver", "alice1111111")
+                                                       ("stake_net_quantity", stake)
+                                                       ("stake_cpu_quantity", stake)
+                                                       ("transfer", false) ) );
+   const int64_t staked = ( stake + stake ).get_amount();
+
+   // toggling the proxy flag recomputes the vote weight of eosio from its stake, once in every week for ten years
+   bool isproxy = false;
+   for( int week = 0; week < 52 * 10; ++week ) {
+      isproxy = !isproxy;
+      BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(regproxy), mvo()
+                                                          ("proxy", "eosio")
+                                                          ("isproxy", isproxy) ) );
+
+      vector<char> data = t.get_row_by_account( config::system_account_name, config::system_account_name, N(votedecay), N(votedecay) );
+      auto decay = t.abi_ser.binary_to_variant( "vote_decay_state", data, eosio_system_tester::abi_serializer_max_time );
+      auto now = t.control->pending_block_time().time_since_epoch().count() / 1000000;
+      BOOST_REQUIRE_EQUAL( (now - (config::block_timestamp_epoch / 1000)) / (86400 * 7), decay["week"].as<int64_t>() );
+
+      // the cached multiplier is the one of the previous formula, applied the same way
+      const double last_vote_weight = t.get_voter_info( N(eosio) )["last_vote_weight"].as_double();
+      BOOST_REQUIRE_EQUAL( double(staked) * decay["multiplier"].as_double(), last_vote_weight );
+      BOOST_REQUIRE_CLOSE_FRACTION( t.stake2votes( asset( staked, core ) ), last_vote_weight, 1e-15 );
+
+      t.produce_block( fc::days(7) );
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( quoteram_leaves_market_untouched ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol core( 8, "TST" );
+
+   t.init_sidechain( core );
+   t.create_sidechain_account( N(alice1111111) );
+   t.produce_blocks();
+
+   const auto ramcore = symbol( 4, "RAMCORE" ).value();
+   const vector<char> before = t.get_row_by_account( config::system_account_name, config::system_account_name, N(rammarket), ramcore );
+   const auto market = t.abi_ser.binary_to_variant( "exchange_state", before, eosio_system_tester::abi_serializer_max_time );
+   const int64_t supply = market["supply"].as<asset>().get_amount();
+   const int64_t ram    = market["base"]["balance"].as<asset>().get_amount();
+   const int64_t tokens = market["quote"]["balance"].as<asset>().get_amount();
+
+   auto quote = [&]( const asset& quant ) {
+      auto trace = t.base_tester::push_action( config::system_account_name, N(quoteram), N(alice1111111), mvo()("quant", quant) );
+      return trace->action_traces[0].console;
+   };
+
+   // buying spends the amount after the .5% fee, selling pays the tokens out minus the fee
+   const int64_t paid   = 100000000 - ( 100000000 + 199 ) / 200;
+   const int64_t issued = eosiosystem::bancor_to_exchange<double>( supply, tokens, paid, .5 );
+   const int64_t bytes  = eosiosystem::bancor_from_exchange<double>( supply + issued, ram, issued, .5 );
+   BOOST_REQUIRE_EQUAL( asset( bytes, symbol( 0, "RAM" ) ).to_string() + "\n", quote( asset( 100000000, core ) ) );
+
+   const int64_t sold     = eosiosystem::bancor_to_exchange<double>( supply, ram, 1024 * 1024, .5 );
+   const int64_t received = eosiosystem::bancor_from_exchange<double>( supply + sold, tokens, sold, .5 );
+   BOOST_REQUIRE_EQUAL( asset( received - ( received + 199 ) / 200, core ).to_string() + "\n", quote( asset( 1024 * 1024, symbol( 0, "RAM" ) ) ) );
+
+   BOOST_REQUIRE_EQUAL( t.wasm_assert_msg( "must quote core token or RAM bytes" ),
+                        t.push_action( N(alice1111111), N(quoteram), mvo()("quant", asset( 1, symbol( 4, "OTHER" ) )) ) );
+   BOOST_REQUIRE( before == t.get_row_by_account( config::system_account_name, config::system_account_name, N(rammarket), ramcore ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( refund_inline_without_delay ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol core( 8, "TST" );
+
+   t.init_sidechain( core );
+   t.create_sidechain_account( N(alice1111111) );
+   t.transfer( config::system_account_name, N(alice1111111), asset( 1000000000, core ) );
+   t.produce_blocks();
+
+   const asset stake( 100000000, core );
+   auto deferred = [&]() { return t.control->db().get_index<eosio::chain::generated_transaction_multi_index>().size(); };
+
+   // without a delay the tokens come back in the undelegatebw transaction itself
+   BOOST_REQUIRE_EQUAL( t.success(), t.stake( N(alice1111111), stake, stake ) );
+   BOOST_REQUIRE_EQUAL( asset( 800000000, core ), t.get_balance( N(alice1111111), core ) );
+   BOOST_REQUIRE_EQUAL( t.success(), t.unstake( N(alice1111111), stake, stake ) );
+   BOOST_REQUIRE_EQUAL( asset( 1000000000, core ), t.get_balance( N(alice1111111), core ) );
+   BOOST_REQUIRE( t.get_refund_request( N(alice1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( 0u, deferred() );
+
+   // with a delay they are held in the refunds table
+   BOOST_REQUIRE_EQUAL( t.error( "missing authority of eosio" ),
+                        t.push_action( N(alice1111111), N(setrefdelay), mvo()("delay_sec", 3 * 24 * 3600) ) );
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(setrefdelay), mvo()("delay_sec", 3 * 24 * 3600) ) );
+   BOOST_REQUIRE_EQUAL( t.success(), t.stake( N(alice1111111), stake, stake ) );
+   BOOST_REQUIRE_EQUAL( t.success(), t.unstake( N(alice1111111), stake, asset( 0, core ) ) );
+   BOOST_REQUIRE_EQUAL( asset( 800000000, core ), t.get_balance( N(alice1111111), core ) );
+   BOOST_REQUIRE_EQUAL( stake, t.get_refund_request( N(alice1111111) )["net_amount"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 1u, deferred() );
+
+   // once the delay is back to 0, the next undelegatebw returns the pending refund as well
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(setrefdelay), mvo()("delay_sec", 0) ) );
+   BOOST_REQUIRE_EQUAL( t.success(), t.unstake( N(alice1111111), asset( 0, core ), stake ) );
+   BOOST_REQUIRE_EQUAL( asset( 1000000000, core ), t.get_balance( N(alice1111111), core ) );
+   BOOST_REQUIRE( t.get_refund_request( N(alice1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( 0u, deferred() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( setacctres_sets_all_limits ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol core( 8, "TST" );
+
+   t.init_sidechain( core );
+   t.produce_blocks();
+
+   auto resources = [&]( account_name a, fc::variant ram, fc::variant net, fc::variant cpu ) {
+      return t.get_action( config::system_account_name, N(setacctres), {{config::system_account_name, config::active_name}},
+                           mvo()("accounts", vector<fc::variant>{ mvo()("account", a)("ram_bytes", ram)("net_weight", net)("cpu_weight", cpu) }) );
+   };
+   auto limits = [&]( account_name a ) {
+      int64_t ram, net, cpu;
+      t.control->get_resource_limits_manager().get_account_limits( a, ram, net, cpu );
+      return std::make_tuple( ram, net, cpu );
+   };
+
+   // a new account gets all of its limits from one setacctres in the newaccount transaction
+   signed_transaction trx;
+   t.set_transaction_headers( trx );
+   trx.actions.emplace_back( vector<permission_level>{{config::system_account_name, config::active_name}},
+                             newaccount{
+                                .creator  = config::system_account_name,
+                                .name     = N(bob111111111),
+                                .owner    = authority( t.get_public_key( N(bob111111111), "owner" ) ),
+                                .active   = authority( t.get_public_key( N(bob111111111), "active" ) )
+                             });
+   trx.actions.emplace_back( resources( N(bob111111111), 2 * 1024 * 1024, 500, 600 ) );
+   t.set_transaction_headers( trx );
+   trx.sign( t.get_private_key( config::system_account_name, "active" ), t.control->get_chain_id() );
+   t.push_transaction( trx );
+   t.produce_block();
+
+   BOOST_REQUIRE( std::make_tuple( int64_t(2 * 1024 * 1024), int64_t(500), int64_t(600) ) == limits( N(bob111111111) ) );
+   BOOST_REQUIRE_EQUAL( 7u, t.get_voter_info( N(bob111111111) )["flags1"].as_uint64() );
+   // RAM stays managed, which eosio.token assumes for accounts it was not told about
+   BOOST_REQUIRE( t.get_row_by_account( N(eosio.token), N(eosio.token), N(rammanaged), N(bob111111111) ).empty() );
+
+   // without a value NET falls back to the staked weight, like setacctnet
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(setacctres), mvo()
+      ("accounts", vector<fc::variant>{ mvo()("account", "bob111111111")("ram_bytes", 2 * 1024 * 1024)("net_weight", fc::variant())("cpu_weight", 700) }) ) );
+   BOOST_REQUIRE( std::make_tuple( int64_t(2 * 1024 * 1024), int64_t(0), int64_t(700) ) == limits( N(bob111111111) ) );
+   BOOST_REQUIRE_EQUAL( 5u, t.get_voter_info( N(bob111111111) )["flags1"].as_uint64() );
+
+   BOOST_REQUIRE_EQUAL( t.wasm_assert_msg( "Network bandwidth of account is already unmanaged" ),
+                        t.push_action( config::system_account_name, N(setacctres), mvo()
+      ("accounts", vector<fc::variant>{ mvo()("account", "bob111111111")("ram_bytes", 2 * 1024 * 1024)("net_weight", fc::variant())("cpu_weight", 700) }) ) );
+   BOOST_REQUIRE_EQUAL( t.error( "missing authority of eosio" ),
+                        t.push_action( N(bob111111111), N(setacctres), mvo()
+      ("accounts", vector<fc::variant>{ mvo()("account", "bob111111111")("ram_bytes", 2 * 1024 * 1024)("net_weight", 1)("cpu_weight", 1) }) ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( newaccounts_batch ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol core( 8, "TST" );
+
+   t.init_sidechain( core );
+   t.create_sidechain_account( N(alice1111111) );
+   t.produce_blocks();
+
+   auto account = [&]( account_name a, fc::variant ram_bytes ) {
+      return mvo()
+         ("account", a)
+         ("owner", authority( t.get_public_key( a, "owner" ) ))
+         ("active", authority( t.get_public_key( a, "active" ) ))
+         ("ram_bytes", ram_bytes)
+         ("net_weight", 1000)
+         ("cpu_weight", -1);
+   };
+
+   BOOST_REQUIRE_EQUAL( t.wasm_assert_msg( "Not authorized to create a sidechain account" ),
+                        t.push_action( N(alice1111111), N(newaccounts), mvo()
+                           ("creator", "alice1111111")
+                           ("accounts", vector<fc::variant>{ account( N(bob111111111), 1024 * 1024 ) }) ) );
+
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(newaccounts), mvo()
+                           ("creator", "eosio")
+                           ("accounts", vector<fc::variant>{ account( N(bob111111111), 1024 * 1024 ),
+                                                              account( N(carol1111111), 2 * 1024 * 1024 ) }) ) );
+   t.produce_block();
+
+   for( auto a : { N(bob111111111), N(carol1111111) } ) {
+      int64_t ram, net, cpu;
+      t.control->get_resource_limits_manager().get_account_limits( a, ram, net, cpu );
+      BOOST_REQUIRE_EQUAL( a == N(bob111111111) ? 1024 * 1024 : 2 * 1024 * 1024, ram );
+      BOOST_REQUIRE_EQUAL( 1000, net );
+      BOOST_REQUIRE_EQUAL( -1, cpu );
+      BOOST_REQUIRE_EQUAL( 7u, t.get_voter_info( a )["flags1"].as_uint64() );
+   }
+
+   // without ram_bytes the limit follows the RAM token balance, which starts at zero for a new account
+   const asset ram_supply = asset::from_string("1000000.00000000 RAM");
+   t.create_currency( N(eosio.token), config::system_account_name, ram_supply );
+   t.issue( config::system_account_name, ram_supply );
+
+   signed_transaction trx;
+   t.set_transaction_headers( trx );
+   trx.actions.emplace_back( t.get_action( config::system_account_name, N(newaccounts), {{config::system_account_name, config::active_name}},
+                                           mvo()("creator", "eosio")("accounts", vector<fc::variant>{ account( N(dave11111111), fc::variant() ) }) ) );
+   trx.actions.emplace_back( t.get_action( N(eosio.token), N(transfer), {{config::system_account_name, config::active_name}},
+                                           mvo()("from", "eosio")("to", "dave11111111")("quantity", "10.00000000 RAM")("memo", "") ) );
+   t.set_transaction_headers( trx );
+   trx.sign( t.get_private_key( config::system_account_name, "active" ), t.control->get_chain_id() );
+   t.push_transaction( trx );
+   t.produce_block();
+
+   int64_t ram, net, cpu;
+   t.control->get_resource_limits_manager().get_account_limits( N(dave11111111), ram, net, cpu );
+   BOOST_REQUIRE_EQUAL( 10000, ram );
+   BOOST_REQUIRE_EQUAL( 6u, t.get_voter_info( N(dave11111111) )["flags1"].as_uint64() );
+
+   // without RAM tokens the new account cannot pay for itself
+   BOOST_REQUIRE_THROW( t.base_tester::push_action( config::system_account_name, N(newaccounts), config::system_account_name, mvo()
+                           ("creator", "eosio")
+                           ("accounts", vector<fc::variant>{ account( N(erin11111111), fc::variant() ) }) ),
+                        ram_usage_exceeded );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( userres_rows_only_for_stakers ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol core( 8, "TST" );
+
+   t.init_sidechain( core );
+   t.create_sidechain_account( N(alice1111111) );
+   t.produce_blocks();
+
+   // a new account costs no userres row, setacctnet without a row falls back to a weight of 0
+   BOOST_REQUIRE( t.get_total_stake( N(alice1111111) ).is_null() );
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(setacctnet), mvo()
+                                                       ("account", "alice1111111")
+                                                       ("net_weight", fc::variant()) ) );
+   int64_t ram, net, cpu;
+   t.control->get_resource_limits_manager().get_account_limits( N(alice1111111), ram, net, cpu );
+   BOOST_REQUIRE_EQUAL( 0, net );
+
+   // without a row the account is still managed, setalimits leaves it alone
+   BOOST_REQUIRE_EQUAL( t.wasm_assert_msg( "cannot use setalimits on an account with managed resources" ),
+                        t.push_action( config::system_account_name, N(setalimits), mvo()
+                                          ("account", "alice1111111")
+                                          ("ram_bytes", -1)
+                                          ("net_weight", -1)
+                                          ("cpu_weight", -1) ) );
+
+   // neither is an account that newaccount left at zero limits
+   t.create_account( N(bob111111111), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( t.wasm_assert_msg( "cannot use setalimits on a sidechain account" ),
+                        t.push_action( config::system_account_name, N(setalimits), mvo()
+                                          ("account", "bob111111111")
+                                          ("ram_bytes", -1)
+                                          ("net_weight", -1)
+                                          ("cpu_weight", -1) ) );
+
+   // the row appears with the first stake and goes away with the last
+   const asset stake( 100000000, core );
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(delegatebw), mvo()
+                                                       ("from", "eosio")
+                                                       ("receiver", "alice1111111")
+                                                       ("stake_net_quantity", stake)
+                                                       ("stake_cpu_quantity", stake)
+                                                       ("transfer", false) ) );
+   BOOST_REQUIRE_EQUAL( stake, t.get_total_stake( N(alice1111111) )["net_weight"].as<asset>() );
+   t.control->get_resource_limits_manager().get_account_limits( N(alice1111111), ram, net, cpu );
+   BOOST_REQUIRE_EQUAL( stake.get_amount(), net );
+
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(undelegatebw), mvo()
+                                                       ("from", "eosio")
+                                                       ("receiver", "alice1111111")
+                                                       ("unstake_net_quantity", stake)
+                                                       ("unstake_cpu_quantity", stake) ) );
+   BOOST_REQUIRE( t.get_total_stake( N(alice1111111) ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( producer_slots_reused ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol core( 8, "TST" );
+
+   t.init_sidechain( core );
+   // the sidechain build rejects voteproducer, the voting build runs update_votes with producer bitsets on the same state
+   t.set_code( config::system_account_name, contracts::util::system_voting_wasm() );
+   for( auto a : { N(alice1111111), N(bob111111111) } ) {
+      t.create_sidechain_account( a );
+      t.regproducer( a );
+   }
+   t.produce_blocks();
+
+   const asset stake( 100000000000ll, core );
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(delegatebw), mvo()
+                                                       ("from", "eosio")
+                                                       ("receiver", "alice1111111")
+                                                       ("stake_net_quantity", stake)
+                                                       ("stake_cpu_quantity", stake)
+                                                       ("transfer", false) ) );
+   const double weight = t.stake2votes( stake + stake );
+
+   auto slot = [&]( uint64_t s ) {
+      vector<char> data = t.get_row_by_account( config::system_account_name, config::system_account_name, N(prodslots), s );
+      return data.empty() ? fc::variant() : t.abi_ser.binary_to_variant( "producer_slot", data, eosio_system_tester::abi_serializer_max_time );
+   };
+   auto bits = [&]() {
+      return t.get_voter_info( N(eosio) )["producer_bits"].as<vector<uint64_t>>();
+   };
+
+   BOOST_REQUIRE_EQUAL( t.success(), t.vote( N(eosio), { N(alice1111111) } ) );
+   BOOST_REQUIRE_EQUAL( "alice1111111", slot(0)["owner"].as_string() );
+   BOOST_REQUIRE_EQUAL( 1u, slot(0)["voters"].as_uint64() );
+   BOOST_REQUIRE( vector<uint64_t>{ 1 } == bits() );
+   BOOST_REQUIRE( t.get_voter_info( N(eosio) )["producers"].get_array().empty() );
+   BOOST_REQUIRE_CLOSE_FRACTION( weight, t.get_producer_info( N(alice1111111) )["total_votes"].as_double(), 1e-15 );
+
+   // alice's slot is freed once no bitset refers to it
+   BOOST_REQUIRE_EQUAL( t.success(), t.vote( N(eosio), { N(bob111111111) } ) );
+   BOOST_REQUIRE_EQUAL( "", slot(0)["owner"].as_string() );
+   BOOST_REQUIRE_EQUAL( 0u, slot(0)["voters"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( "bob111111111", slot(1)["owner"].as_string() );
+   BOOST_REQUIRE( vector<uint64_t>{ 2 } == bits() );
+   BOOST_REQUIRE_EQUAL( 0, t.get_producer_info( N(alice1111111) )["total_votes"].as_double() );
+   BOOST_REQUIRE_CLOSE_FRACTION( weight, t.get_producer_info( N(bob111111111) )["total_votes"].as_double(), 1e-15 );
+
+   // and taken by the next producer voted for instead of a new one
+   BOOST_REQUIRE_EQUAL( t.success(), t.vote( N(eosio), { N(alice1111111), N(bob111111111) } ) );
+   BOOST_REQUIRE_EQUAL( "alice1111111", slot(0)["owner"].as_string() );
+   BOOST_REQUIRE( vector<uint64_t>{ 3 } == bits() );
+   BOOST_REQUIRE( slot(2).is_null() );
+   BOOST_REQUIRE_CLOSE_FRACTION( weight, t.get_producer_info( N(alice1111111) )["total_votes"].as_double(), 1e-15 );
+   BOOST_REQUIRE_CLOSE_FRACTION( weight, t.get_producer_info( N(bob111111111) )["total_votes"].as_double(), 1e-15 );
+
+   // a stake change recasts the vote through changebw without touching the slots
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(undelegatebw), mvo()
+                                                       ("from", "eosio")
+                                                       ("receiver", "alice1111111")
+                                                       ("unstake_net_quantity", stake)
+                                                       ("unstake_cpu_quantity", asset( 0, core )) ) );
+   BOOST_REQUIRE_EQUAL( 1u, slot(0)["voters"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 1u, slot(1)["voters"].as_uint64() );
+   BOOST_REQUIRE_CLOSE_FRACTION( t.stake2votes( stake ), t.get_producer_info( N(bob111111111) )["total_votes"].as_double(), 1e-12 );
+
+   BOOST_REQUIRE_EQUAL( t.success(), t.vote( N(eosio), vector<account_name>() ) );
+   BOOST_REQUIRE_EQUAL( "", slot(0)["owner"].as_string() );
+   BOOST_REQUIRE_EQUAL( "", slot(1)["owner"].as_string() );
+   BOOST_REQUIRE( bits().empty() );
+   BOOST_REQUIRE_EQUAL( 0, t.get_producer_info( N(bob111111111) )["total_votes"].as_double() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( unpaid_blocks_pending_and_folded ) try {
+   eosio_system_tester t( eosio_system_tester::setup_level::minimal );
+   const symbol core( 8, "TST" );
+   const account_name producer = config::system_account_name;
+
+   t.init_sidechain( core );
+   // onblock only counts blocks once enough stake voted, which takes the voting build
+   t.set_code( config::system_account_name, contracts::util::system_voting_wasm() );
+   t.create_sidechain_account( N(alice1111111) );
+   t.regproducer( producer );
+
+   const asset stake( 100000000000000ll, core );
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( config::system_account_name, N(delegatebw), mvo()
+                                                       ("from", "eosio")
+                                                       ("receiver", "alice1111111")
+                                                       ("stake_net_quantity", stake)
+                                                       ("stake_cpu_quantity", stake)
+                                                       ("transfer", false) ) );
+   BOOST_REQUIRE_EQUAL( t.success(), t.vote( config::system_account_name, { producer } ) );
+
+   auto row_unpaid_blocks = [&]() {
+      return t.get_producer_info( producer )["unpaid_blocks"].as<uint32_t>();
+   };
+   auto row_total_unpaid_blocks = [&]() {
+      return t.get_global_state()["total_unpaid_blocks"].as<uint32_t>();
+   };
+
+   // the first counted block also updated the schedule, which folded it right away
+   BOOST_REQUIRE( t.get_pending_unpaid_blocks().empty() );
+   BOOST_REQUIRE_EQUAL( 1u, row_unpaid_blocks() );
+   BOOST_REQUIRE_EQUAL( 1u, row_total_unpaid_blocks() );
+
+   // the next blocks are only counted in the unpaidblocks row of the producer
+   t.produce_blocks( 10 );
+   BOOST_REQUIRE_EQUAL( 10u, t.get_pending_unpaid_blocks()[producer] );
+   BOOST_REQUIRE_EQUAL( 1u, row_unpaid_blocks() );
+   BOOST_REQUIRE_EQUAL( 1u, row_total_unpaid_blocks() );
+
+   // until update_elected_producers folds them into the rows
+   const string last_update = t.get_global_state()["last_producer_schedule_update"].as_string();
+   uint32_t blocks = 0;
+   do {
+      t.produce_block();
+      ++blocks;
+   } while( last_update == t.get_global_state()["last_producer_schedule_update"].as_string() );
+   BOOST_REQUIRE( t.get_pending_unpaid_blocks().empty() );
+   BOOST_REQUIRE_EQUAL( 11u + blocks, row_unpaid_blocks() );
+   BOOST_REQUIRE_EQUAL( 11u + blocks, row_total_unpaid_blocks() );
+
+   // claimrewards folds the pending blocks before it pays
+   t.produce_block( fc::days(1) );
+   t.produce_blocks( 5 );
+   BOOST_REQUIRE( 0u < t.get_pending_unpaid_blocks()[producer] );
+
+   auto supply = [&]() {
+      return t.get_stats( "8,TST" )["supply"].as<asset>().get_amount();
+   };
+   auto balance = [&]( account_name a ) {
+      return t.get_balance( a, core ).get_amount();
+   };
+   const auto initial_state     = t.get_global_state();
+   const int64_t initial_supply = supply();
+   const int64_t initial_saving = balance( N(eosio.saving) );
+   const int64_t initial_bpay   = balance( N(eosio.bpay) );
+   const int64_t initial_vpay   = balance( N(eosio.vpay) );
+
+   BOOST_REQUIRE_EQUAL( t.success(), t.push_action( producer, N(claimrewards), mvo()("owner", producer) ) );
+   BOOST_REQUIRE_EQUAL( 0u, row_unpaid_blocks() );
+   BOOST_REQUIRE_EQUAL( 0u, row_total_unpaid_blocks() );
+   BOOST_REQUIRE_EQUAL( 0, t.get_global_state()["perblock_bucket"].as<int64_t>() );
+
+   // the buckets got what the issue to eosio and the three transfers credited them with
+   const auto state = t.get_global_state();
+   const int64_t usecs_since_last_fill = t.microseconds_since_epoch_of_iso_string( state["last_pervote_bucket_fill"] )
+                                       - t.microseconds_since_epoch_of_iso_string( initial_state["last_pervote_bucket_fill"] );
+   const double continuous_rate = 0.04879;
+   const int64_t useconds_per_year = 52 * 7 * 24 * 3600 * 1000000ll;
+   const int64_t new_tokens       = static_cast<int64_t>( (continuous_rate * double(initial_supply) * double(usecs_since_last_fill)) / double(useconds_per_year) );
+   const int64_t to_producers     = new_tokens / 5;
+   const int64_t to_savings       = new_tokens - to_producers;
+   const int64_t to_per_block_pay = to_producers / 4;
+   const int64_t to_per_vote_pay  = to_producers - to_per_block_pay;
+   BOOST_REQUIRE( 0 < to_per_block_pay );
+
+   const int64_t block_pay = initial_state["perblock_bucket"].as<int64_t>() + to_per_block_pay - state["perblock_bucket"].as<int64_t>();
+   const int64_t vote_pay  = initial_state["pervote_bucket"].as<int64_t>() + to_per_vote_pay - state["pervote_bucket"].as<int64_t>();
+   BOOST_REQUIRE_EQUAL( initial_supply + new_tokens, supply() );
+   BOOST_REQUIRE_EQUAL( initial_saving + to_savings, balance( N(eosio.saving) ) );
+   BOOST_REQUIRE_EQUAL( initial_bpay + to_per_block_pay - block_pay, balance( N(eosio.bpay) ) );
+   BOOST_REQUIRE_EQUAL( initial_vpay + to_per_vote_pay - vote_pay, balance( N(eosio.vpay) ) );
+   // only the block started after the claim is pending
+   BOOST_REQUIRE_EQUAL( 1u, t.get_pending_unpaid_blocks()[producer] );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
+
+
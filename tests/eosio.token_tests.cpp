@@ -59,7 +59,13 @@ public:
    {
       auto symb = eosio::chain::symbol::from_string(symbolname);
       auto symbol_code = symb.to_symbol_code().value;
-      vector<char> data = get_row_by_account( N(eosio.token), acc, N(accounts), symbol_code );
+      vector<char> data = get_row_by_account( N(eosio.token), acc, N(balances), symbol_code );
+      if( !data.empty() ) {
+         // compact rows hold only the amount, the symbol comes from the primary key
+         auto amount = abi_ser.binary_to_variant( "compact_account", data, abi_serializer_max_time )["amount"].as<int64_t>();
+         return mvo()( "balance", asset( amount, symb ) );
+      }
+      data = get_row_by_account( N(eosio.token), acc, N(accounts), symbol_code );
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "account", data, abi_serializer_max_time );
    }
 
@@ -80,6 +86,20 @@ public:
       );
    }
 
+   action_result issuemany( account_name issuer, const vector<std::pair<account_name, asset>>& issues, string memo ) {
+      variants items;
+      for( const auto& i : issues ) {
+         items.emplace_back( mvo()
+              ( "to", i.first )
+              ( "quantity", i.second )
+         );
+      }
+      return push_action( issuer, N(issuemany), mvo()
+           ( "issues", items )
+           ( "memo", memo )
+      );
+   }
+
    action_result retire( account_name issuer, asset quantity, string memo ) {
       return push_action( issuer, N(retire), mvo()
            ( "quantity", quantity)
@@ -100,6 +120,56 @@ public:
       );
    }
 
+   action_result transferbatch( account_name from,
+                                const vector<std::pair<account_name, asset>>& transfers,
+                                string memo ) {
+      variants items;
+      for( const auto& t : transfers ) {
+         items.emplace_back( mvo()
+              ( "to", t.first )
+              ( "quantity", t.second )
+              ( "memo", memo )
+         );
+      }
+      return push_action( from, N(transferbatch), mvo()
+           ( "from", from )
+           ( "transfers", items )
+      );
+   }
+
+   uint32_t billed_cpu( account_name signer, vector<action> actions ) {
+      signed_transaction trx;
+      trx.actions = std::move(actions);
+      set_transaction_headers( trx );
+      trx.sign( get_private_key( signer, "active" ), control->get_chain_id() );
+      auto trace = push_transaction( trx );
+      produce_blocks();
+      return trace->receipt->cpu_usage_us;
+   }
+
+   action_result checkpoint( account_name issuer, const string& symbolname ) {
+      return push_action( issuer, N(checkpoint), mvo()
+           ( "symbol", symbolname )
+      );
+   }
+
+   action_result compactbal( account_name issuer, const string& symbolname ) {
+      return push_action( issuer, N(compactbal), mvo()
+           ( "symbol", symbolname )
+      );
+   }
+
+   fc::variant get_checkpoint( account_name acc, uint64_t id ) {
+      vector<char> data = get_row_by_account( N(eosio.token), acc, N(checkpoints), id );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "balance_checkpoint", data, abi_serializer_max_time );
+   }
+
+   fc::variant get_holder( account_name acc, const string& symbolname ) {
+      auto symbol_code = eosio::chain::symbol::from_string(symbolname).to_symbol_code().value;
+      vector<char> data = get_row_by_account( N(eosio.token), symbol_code, N(holders), acc );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "holder", data, abi_serializer_max_time );
+   }
+
    action_result open( account_name owner,
                        const string& symbolname,
                        account_name ram_payer    ) {
@@ -412,4 +482,329 @@ BOOST_FIXTURE_TEST_CASE( close_tests, eosio_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( transferbatch_tests, eosio_token_tester ) try {
+
+   auto token = create( N(alice), asset::from_string("1000.00000000 TKN"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("1000.00000000 TKN"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( success(), transferbatch( N(alice), { { N(bob),   asset::from_string("300.00000000 TKN") },
+                                                               { N(carol), asset::from_string("200.00000000 TKN") },
+                                                               { N(bob),   asset::from_string("50.00000000 TKN") } }, "hola" ) );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "8,TKN"), mvo()
+      ("balance", "450.00000000 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "8,TKN"), mvo()
+      ("balance", "350.00000000 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "8,TKN"), mvo()
+      ("balance", "200.00000000 TKN")
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn balance" ),
+      transferbatch( N(alice), { { N(bob),   asset::from_string("400.00000000 TKN") },
+                                 { N(carol), asset::from_string("100.00000000 TKN") } }, "hola" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot transfer to self" ),
+      transferbatch( N(alice), { { N(alice), asset::from_string("1.00000000 TKN") } }, "hola" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must transfer positive quantity" ),
+      transferbatch( N(alice), { { N(bob), asset::from_string("-1.00000000 TKN") } }, "hola" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+      transferbatch( N(alice), { { N(bob), asset::from_string("1.0000 TKN") } }, "hola" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no transfers specified" ),
+      transferbatch( N(alice), {}, "hola" )
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( transferbatch_cpu_benchmark, eosio_token_tester ) try {
+
+   const size_t recipients = 50;
+
+   vector<account_name> accounts;
+   for( size_t i = 0; i < recipients; ++i ) {
+      accounts.emplace_back( "rcpt" + std::string(1, 'a' + i / 26) + std::string(1, 'a' + i % 26) );
+   }
+   create_accounts( accounts );
+
+   create( N(alice), asset::from_string("1000000.00000000 TKN") );
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("1000000.00000000 TKN"), "hola" ) );
+   produce_blocks(1);
+
+   const auto quantity = asset::from_string("1.00000000 TKN");
+
+   // open all balance rows first so both variants measure the same modify-only path
+   vector<action> singles;
+   variants items;
+   for( const auto& a : accounts ) {
+      singles.emplace_back( get_action( N(eosio.token), N(transfer), { permission_level{N(alice), config::active_name} }, mvo()
+         ("from", "alice")
+         ("to", a)
+         ("quantity", quantity)
+         ("memo", "")
+      ) );
+      items.emplace_back( mvo()("to", a)("quantity", quantity)("memo", "") );
+   }
+   billed_cpu( N(alice), singles );
+
+   const uint32_t single_cpu = billed_cpu( N(alice), singles );
+   const uint32_t batch_cpu  = billed_cpu( N(alice), { get_action( N(eosio.token), N(transferbatch),
+                                                                   { permission_level{N(alice), config::active_name} }, mvo()
+                                                                   ("from", "alice")
+                                                                   ("transfers", items) ) } );
+
+   BOOST_TEST_MESSAGE( "billed cpu for " << recipients << " transfers: " << single_cpu << " us, "
+                       << "transferbatch: " << batch_cpu << " us" );
+
+   REQUIRE_MATCHING_OBJECT( get_account(accounts.front(), "8,TKN"), mvo()
+      ("balance", "3.00000000 TKN")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( issuemany_tests, eosio_token_tester ) try {
+
+   auto token = create( N(alice), asset::from_string("1000.00000000 TKN"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), issuemany( N(alice), { { N(alice), asset::from_string("100.00000000 TKN") },
+                                                           { N(bob),   asset::from_string("200.00000000 TKN") },
+                                                           { N(carol), asset::from_string("300.00000000 TKN") } }, "airdrop" ) );
+
+   auto stats = get_stats("8,TKN");
+   BOOST_REQUIRE_EQUAL( "600.00000000 TKN", stats["supply"].as_string() );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "8,TKN"), mvo()
+      ("balance", "100.00000000 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "8,TKN"), mvo()
+      ("balance", "200.00000000 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "8,TKN"), mvo()
+      ("balance", "300.00000000 TKN")
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "quantity exceeds available supply" ),
+      issuemany( N(alice), { { N(bob), asset::from_string("300.00000000 TKN") }, { N(carol), asset::from_string("101.00000000 TKN") } }, "airdrop" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must issue positive quantity" ),
+      issuemany( N(alice), { { N(bob), asset::from_string("-1.00000000 TKN") } }, "airdrop" )
+   );
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ),
+      issuemany( N(bob), { { N(bob), asset::from_string("1.00000000 TKN") } }, "airdrop" )
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( compact_balance_migration, eosio_token_tester ) try {
+
+   // rows written by tether.token have the legacy asset layout in accounts
+   set_code( N(eosio.token), contracts::tether_wasm() );
+   set_abi( N(eosio.token), contracts::tether_abi().data() );
+   produce_blocks();
+
+   base_tester::push_action( N(eosio.token), N(create), N(eosio.token), mvo()
+      ("issuer", "alice")
+      ("maximum_supply", "1000.00000000 TKN")
+   );
+   base_tester::push_action( N(eosio.token), N(issue), N(alice), mvo()
+      ("to", "bob")
+      ("quantity", "600.00000000 TKN")
+      ("memo", "")
+   );
+   produce_blocks();
+
+   set_code( N(eosio.token), contracts::token_wasm() );
+   set_abi( N(eosio.token), contracts::token_abi().data() );
+   produce_blocks();
+
+   const auto sym_code = symbol::from_string("8,TKN").to_symbol_code();
+
+   // until the issuer asks for it, balances stay in accounts where get_currency_balance reads them
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(carol), asset::from_string("50.00000000 TKN"), "hola" ) );
+   for( auto acc : { N(bob), N(carol) } ) {
+      BOOST_REQUIRE_EQUAL( false, get_row_by_account( N(eosio.token), acc, N(accounts), sym_code ).empty() );
+      BOOST_REQUIRE_EQUAL( true, get_row_by_account( N(eosio.token), acc, N(balances), sym_code ).empty() );
+   }
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ), compactbal( N(bob), "TKN" ) );
+   BOOST_REQUIRE_EQUAL( success(), compactbal( N(alice), "TKN" ) );
+   BOOST_REQUIRE_EQUAL( true, get_stats("8,TKN")["compact_balances"].as_bool() );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "balances already compact" ), compactbal( N(alice), "TKN" ) );
+   produce_blocks();
+
+   // the sender's row is moved at its own expense, the recipient's legacy row is updated in place
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(alice), asset::from_string("100.00000000 TKN"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( true, get_row_by_account( N(eosio.token), N(bob), N(accounts), sym_code ).empty() );
+   BOOST_REQUIRE_EQUAL( false, get_row_by_account( N(eosio.token), N(bob), N(balances), sym_code ).empty() );
+   BOOST_REQUIRE_EQUAL( false, get_row_by_account( N(eosio.token), N(alice), N(accounts), sym_code ).empty() );
+   BOOST_REQUIRE_EQUAL( true, get_row_by_account( N(eosio.token), N(alice), N(balances), sym_code ).empty() );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "8,TKN"), mvo()
+      ("balance", "100.00000000 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "8,TKN"), mvo()
+      ("balance", "450.00000000 TKN")
+   );
+
+   // accounts without a row get a compact one
+   create_accounts( { N(dave) } );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(dave), asset::from_string("10.00000000 TKN"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( true, get_row_by_account( N(eosio.token), N(dave), N(accounts), sym_code ).empty() );
+   REQUIRE_MATCHING_OBJECT( get_account(N(dave), "8,TKN"), mvo()
+      ("balance", "10.00000000 TKN")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( compact_balance_ram_benchmark, eosio_token_tester ) try {
+
+   const size_t holders = 200;
+
+   vector<account_name> accounts;
+   for( size_t i = 0; i < holders; ++i ) {
+      accounts.emplace_back( "hldr" + std::string(1, 'a' + i / 26) + std::string(1, 'a' + i % 26) );
+   }
+   create_accounts( accounts );
+   create_accounts( { N(tether.token) } );
+   set_code( N(tether.token), contracts::tether_wasm() );
+   set_abi( N(tether.token), contracts::tether_abi().data() );
+
+   create( N(alice), asset::from_string("1000000.00000000 TKN") );
+   BOOST_REQUIRE_EQUAL( success(), compactbal( N(alice), "TKN" ) );
+   base_tester::push_action( N(tether.token), N(create), N(tether.token), mvo()
+      ("issuer", "alice")
+      ("maximum_supply", "1000000.00000000 TKN")
+   );
+   produce_blocks();
+
+   variants issues;
+   for( const auto& a : accounts ) {
+      issues.emplace_back( mvo()("to", a)("quantity", "1.00000000 TKN") );
+   }
+
+   // alice pays for every holder row in both contracts
+   auto rlm = control->get_resource_limits_manager();
+   auto ram_before = rlm.get_account_ram_usage( N(alice) );
+   base_tester::push_action( N(tether.token), N(issuemany), N(alice), mvo()("issues", issues)("memo", "") );
+   const int64_t legacy_row = (rlm.get_account_ram_usage( N(alice) ) - ram_before) / holders;
+
+   ram_before = rlm.get_account_ram_usage( N(alice) );
+   base_tester::push_action( N(eosio.token), N(issuemany), N(alice), mvo()("issues", issues)("memo", "") );
+   const int64_t compact_row = (rlm.get_account_ram_usage( N(alice) ) - ram_before) / holders;
+
+   BOOST_TEST_MESSAGE( "ram per holder: accounts " << legacy_row << " bytes, balances " << compact_row << " bytes, "
+                       << "saving " << (legacy_row - compact_row) * 1000000 / 1024 / 1024 << " MiB per 1M holders" );
+
+   // the symbol is the only field dropped
+   BOOST_REQUIRE_EQUAL( legacy_row - int64_t(sizeof(uint64_t)), compact_row );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( checkpoint_tests, eosio_token_tester ) try {
+
+   auto token = create( N(alice), asset::from_string("1000.00000000 TKN"));
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("1000.00000000 TKN"), "hola" ) );
+
+   // nothing is recorded before the first checkpoint
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(bob), asset::from_string("100.00000000 TKN"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( true, get_checkpoint( N(alice), 0 ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ), checkpoint( N(bob), "TKN" ) );
+   BOOST_REQUIRE_EQUAL( success(), checkpoint( N(alice), "TKN" ) );
+   BOOST_REQUIRE_EQUAL( 1u, get_stats("8,TKN")["epoch"].as_uint64() );
+   produce_blocks(1);
+
+   // only the first change after a checkpoint stores the balance it replaces
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(bob), asset::from_string("50.00000000 TKN"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(carol), asset::from_string("10.00000000 TKN"), "hola" ) );
+
+   REQUIRE_MATCHING_OBJECT( get_checkpoint( N(alice), 0 ), mvo()
+      ("id", 0)
+      ("sym", "TKN")
+      ("epoch", 1)
+      ("amount", 90000000000ll)
+   );
+   BOOST_REQUIRE_EQUAL( true, get_checkpoint( N(alice), 1 ).is_null() );
+   REQUIRE_MATCHING_OBJECT( get_checkpoint( N(bob), 0 ), mvo()
+      ("id", 0)
+      ("sym", "TKN")
+      ("epoch", 1)
+      ("amount", 10000000000ll)
+   );
+   // carol had no balance at checkpoint 1
+   REQUIRE_MATCHING_OBJECT( get_checkpoint( N(carol), 0 ), mvo()
+      ("id", 0)
+      ("sym", "TKN")
+      ("epoch", 1)
+      ("amount", 0)
+   );
+
+   BOOST_REQUIRE_EQUAL( success(), checkpoint( N(alice), "TKN" ) );
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(alice), asset::from_string("5.00000000 TKN"), "hola" ) );
+
+   REQUIRE_MATCHING_OBJECT( get_checkpoint( N(alice), 1 ), mvo()
+      ("id", 1)
+      ("sym", "TKN")
+      ("epoch", 2)
+      ("amount", 84000000000ll)
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( holders_tests, eosio_token_tester ) try {
+
+   auto token = create( N(alice), asset::from_string("1000.00000000 TKN"));
+   BOOST_REQUIRE_EQUAL( success(), issue( N(alice), N(alice), asset::from_string("1000.00000000 TKN"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(bob), asset::from_string("100.00000000 TKN"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( true, get_holder( N(alice), "8,TKN" ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ),
+                        push_action( N(bob), N(trackholders), mvo()("symbol", "TKN")("track", true) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(trackholders), mvo()("symbol", "TKN")("track", true) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "holders already tracked" ),
+                        push_action( N(alice), N(trackholders), mvo()("symbol", "TKN")("track", true) ) );
+   produce_blocks(1);
+
+   // balances touched after tracking started are indexed, untouched ones need syncholder
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(carol), asset::from_string("200.00000000 TKN"), "hola" ) );
+   REQUIRE_MATCHING_OBJECT( get_holder( N(alice), "8,TKN" ), mvo()
+      ("owner", "alice")
+      ("amount", 70000000000ll)
+   );
+   REQUIRE_MATCHING_OBJECT( get_holder( N(carol), "8,TKN" ), mvo()
+      ("owner", "carol")
+      ("amount", 20000000000ll)
+   );
+   BOOST_REQUIRE_EQUAL( true, get_holder( N(bob), "8,TKN" ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(syncholder), mvo()("owner", "bob")("symbol", "TKN") ) );
+   REQUIRE_MATCHING_OBJECT( get_holder( N(bob), "8,TKN" ), mvo()
+      ("owner", "bob")
+      ("amount", 10000000000ll)
+   );
+
+   // an emptied balance leaves the index
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(carol), N(bob), asset::from_string("200.00000000 TKN"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( true, get_holder( N(carol), "8,TKN" ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(trackholders), mvo()("symbol", "TKN")("track", false) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice), N(syncholder), mvo()("owner", "bob")("symbol", "TKN") ) );
+   BOOST_REQUIRE_EQUAL( true, get_holder( N(bob), "8,TKN" ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
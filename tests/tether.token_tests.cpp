@@ -63,6 +63,12 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "account", data, abi_serializer_max_time );
    }
 
+   fc::variant get_frozen_stats()
+   {
+      vector<char> data = get_row_by_account( N(tether.token), N(tether.token), N(frozenstat), N(frozenstat) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "frozen_stats", data, abi_serializer_max_time );
+   }
+
    action_result create( account_name issuer,
                 asset        maximum_supply ) {
 
@@ -80,6 +86,20 @@ public:
       );
    }
 
+   action_result issuemany( account_name issuer, const vector<std::pair<account_name, asset>>& issues, string memo ) {
+      variants items;
+      for( const auto& i : issues ) {
+         items.emplace_back( mvo()
+              ( "to", i.first )
+              ( "quantity", i.second )
+         );
+      }
+      return push_action( issuer, N(issuemany), mvo()
+           ( "issues", items )
+           ( "memo", memo )
+      );
+   }
+
    action_result retire( account_name issuer, asset quantity, string memo ) {
       return push_action( issuer, N(retire), mvo()
            ( "quantity", quantity)
@@ -450,7 +470,10 @@ BOOST_FIXTURE_TEST_CASE( freeze_tests, tether_token_tester ) try {
    BOOST_REQUIRE_EQUAL( success(), transfer( N(tether.token), N(bob), asset::from_string("200 CERO"), "hola" ) );
    BOOST_REQUIRE_EQUAL( success(), transfer( N(bob), N(tether.token), asset::from_string("1 CERO"), "hola" ) );
 
+   BOOST_REQUIRE_EQUAL( true, get_frozen_stats().is_null() );
+
    BOOST_REQUIRE_EQUAL( success(), freeze( N(bob), N(tether.token) ) );
+   BOOST_REQUIRE_EQUAL( 1, get_frozen_stats()["count"].as_uint64() );
 
    BOOST_REQUIRE_EQUAL( wasm_assert_msg( "account is frozen" ),
                         transfer( N(tether.token), N(bob), asset::from_string("1 CERO"), "hola" ) );
@@ -468,6 +491,7 @@ BOOST_FIXTURE_TEST_CASE( freeze_tests, tether_token_tester ) try {
                         freeze( N(bob), N(tether.token) ) );
 
    BOOST_REQUIRE_EQUAL( success(), unfreeze( N(bob), N(tether.token) ) );
+   BOOST_REQUIRE_EQUAL( 0, get_frozen_stats()["count"].as_uint64() );
 
    BOOST_REQUIRE_EQUAL( success(), issue( N(tether.token), N(bob), asset::from_string("1 CERO"), "hola" ) );
    BOOST_REQUIRE_EQUAL( success(), transfer( N(tether.token), N(bob), asset::from_string("1 CERO"), "hola" ) );
@@ -486,6 +510,40 @@ BOOST_FIXTURE_TEST_CASE( freeze_tests, tether_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( frozen_count_without_frozenstat, tether_token_tester ) try {
+
+   // accounts frozen by the contract deployed before frozenstat existed
+   set_code( N(tether.token), contracts::util::tether_wasm_old() );
+   set_abi( N(tether.token), contracts::util::tether_abi_old().data() );
+   produce_blocks();
+
+   auto token = create( N(tether.token), asset::from_string("2000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( N(tether.token), N(tether.token), asset::from_string("1000 CERO"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(tether.token), N(alice), asset::from_string("100 CERO"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( success(), freeze( N(alice), N(tether.token) ) );
+   BOOST_REQUIRE_EQUAL( success(), freeze( N(bob), N(tether.token) ) );
+   BOOST_REQUIRE_EQUAL( true, get_frozen_stats().is_null() );
+
+   // after the upgrade the count is taken from the frozen rows
+   set_code( N(tether.token), contracts::tether_wasm() );
+   set_abi( N(tether.token), contracts::tether_abi().data() );
+   produce_blocks();
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "account is frozen" ),
+                        transfer( N(alice), N(tether.token), asset::from_string("1 CERO"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( success(), unfreeze( N(bob), N(tether.token) ) );
+   BOOST_REQUIRE_EQUAL( 1, get_frozen_stats()["count"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "account is frozen" ),
+                        transfer( N(alice), N(tether.token), asset::from_string("1 CERO"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( success(), unfreeze( N(alice), N(tether.token) ) );
+   BOOST_REQUIRE_EQUAL( 0, get_frozen_stats()["count"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(tether.token), asset::from_string("1 CERO"), "hola" ) );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( pause_tests, tether_token_tester ) try {
 
    auto supply = asset::from_string("5000 CERO");
@@ -554,4 +612,40 @@ BOOST_FIXTURE_TEST_CASE( pause_tests, tether_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( issuemany_tests, tether_token_tester ) try {
+
+   auto token = create( N(alice), asset::from_string("1000 CERO"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), issuemany( N(alice), { { N(alice), asset::from_string("100 CERO") },
+                                                           { N(bob),   asset::from_string("200 CERO") },
+                                                           { N(carol), asset::from_string("300 CERO") } }, "airdrop" ) );
+
+   auto stats = get_stats("0,CERO");
+   BOOST_REQUIRE_EQUAL( "600 CERO", stats["supply"].as_string() );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()
+      ("balance", "100 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "0,CERO"), mvo()
+      ("balance", "200 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "0,CERO"), mvo()
+      ("balance", "300 CERO")
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "quantity exceeds available supply" ),
+      issuemany( N(alice), { { N(bob), asset::from_string("300 CERO") }, { N(carol), asset::from_string("101 CERO") } }, "airdrop" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must issue positive quantity" ),
+      issuemany( N(alice), { { N(bob), asset::from_string("-1 CERO") } }, "airdrop" )
+   );
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ),
+      issuemany( N(bob), { { N(bob), asset::from_string("1 CERO") } }, "airdrop" )
+   );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
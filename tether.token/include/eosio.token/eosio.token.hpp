@@ -6,8 +6,12 @@
 
 #include <eosiolib/asset.hpp>
 #include <eosiolib/eosio.hpp>
+#include <eosiolib/singleton.hpp>
+
+#include <eosio.token/basic_token.hpp>
 
 #include <string>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -17,12 +21,9 @@ namespace eosio {
 
    using std::string;
 
-   class [[eosio::contract("tether.token")]] token : public contract {
+   class [[eosio::contract("tether.token")]] token : public basic_token<token, default_token_policy> {
       public:
-         using contract::contract;
-
-         token( name receiver, name code, datastream<const char*> ds ) : contract(receiver, code, ds),
-          _frozen_accounts(_self, _self.value){ }
+         using basic_token::basic_token;
 
          [[eosio::action]]
          void create( name   issuer,
@@ -31,6 +32,14 @@ namespace eosio {
          [[eosio::action]]
          void issue( name to, asset quantity, string memo );
 
+         /**
+          *  Issues to many recipients in one action. The supply is checked against and
+          *  updated by the total once, and recipients are credited directly instead of
+          *  through an inline transfer from the issuer.
+          */
+         [[eosio::action]]
+         void issuemany( const std::vector<issue_item>& issues, string memo );
+
          [[eosio::action]]
          void retire( asset quantity, string memo );
 
@@ -58,22 +67,9 @@ namespace eosio {
          [[eosio::action]]
          void unpause( const symbol_code& symbol );
 
-         static asset get_supply( name token_contract_account, symbol_code sym_code )
-         {
-            stats statstable( token_contract_account, sym_code.raw() );
-            const auto& st = statstable.get( sym_code.raw() );
-            return st.supply;
-         }
-
-         static asset get_balance( name token_contract_account, name owner, symbol_code sym_code )
-         {
-            accounts accountstable( token_contract_account, owner.value );
-            const auto& ac = accountstable.get( sym_code.raw() );
-            return ac.balance;
-         }
-
          using create_action = eosio::action_wrapper<"create"_n, &token::create>;
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
+         using issuemany_action = eosio::action_wrapper<"issuemany"_n, &token::issuemany>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
@@ -104,15 +100,20 @@ namespace eosio {
             uint64_t primary_key()const { return account.value; }
          };
 
+         /**
+          *  Number of rows in the frozen table, kept by freeze/unfreeze so that
+          *  balance changes can skip the frozen lookup while nobody is frozen.
+          */
+         struct [[eosio::table("frozenstat")]] frozen_stats {
+            uint64_t count = 0;
+         };
+
          typedef eosio::multi_index< "accounts"_n, account > accounts;
          typedef eosio::multi_index< "stat"_n, currency_stats > stats;
          typedef eosio::multi_index< "frozen"_n, frozen_account > frozen_accounts;
+         typedef eosio::singleton< "frozenstat"_n, frozen_stats > frozen_stats_singleton;
 
-         void sub_balance( name owner, asset value );
-         void add_balance( name owner, asset value, name ram_payer );
-
-         frozen_accounts _frozen_accounts;
-         bool is_frozen( name owner );
+         friend class basic_token<token, default_token_policy>;
    };
 
 } /// namespace eosio
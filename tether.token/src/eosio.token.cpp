@@ -10,78 +10,22 @@ namespace eosio {
 void token::create( name   issuer,
                     asset  maximum_supply )
 {
-    require_auth( _self );
-
-    auto sym = maximum_supply.symbol;
-    eosio::check( sym.is_valid(), "invalid symbol name" );
-    eosio::check( maximum_supply.is_valid(), "invalid supply");
-    eosio::check( maximum_supply.amount > 0, "max-supply must be positive");
-
-    stats statstable( _self, sym.code().raw() );
-    auto existing = statstable.find( sym.code().raw() );
-    eosio::check( existing == statstable.end(), "token with symbol already exists" );
-
-    statstable.emplace( _self, [&]( auto& s ) {
-       s.supply.symbol = maximum_supply.symbol;
-       s.max_supply    = maximum_supply;
-       s.issuer        = issuer;
-    });
+   basic_token::create( issuer, maximum_supply );
 }
 
-
 void token::issue( name to, asset quantity, string memo )
 {
-    auto sym = quantity.symbol;
-    eosio::check( sym.is_valid(), "invalid symbol name" );
-    eosio::check( memo.size() <= 256, "memo has more than 256 bytes" );
-
-    stats statstable( _self, sym.code().raw() );
-    auto existing = statstable.find( sym.code().raw() );
-    eosio::check( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
-    const auto& st = *existing;
-
-    require_auth( st.issuer );
-    eosio::check( quantity.is_valid(), "invalid quantity" );
-    eosio::check( quantity.amount > 0, "must issue positive quantity" );
-
-    eosio::check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-    eosio::check( quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
-
-    statstable.modify( st, same_payer, [&]( auto& s ) {
-       s.supply += quantity;
-    });
-
-    add_balance( st.issuer, quantity, st.issuer );
+   basic_token::issue( to, quantity, memo );
+}
 
-    if( to != st.issuer ) {
-      SEND_INLINE_ACTION( *this, transfer, { {st.issuer, "active"_n} },
-                          { st.issuer, to, quantity, memo }
-      );
-    }
+void token::issuemany( const std::vector<issue_item>& issues, string memo )
+{
+   basic_token::issuemany( issues, memo );
 }
 
 void token::retire( asset quantity, string memo )
 {
-    auto sym = quantity.symbol;
-    eosio::check( sym.is_valid(), "invalid symbol name" );
-    eosio::check( memo.size() <= 256, "memo has more than 256 bytes" );
-
-    stats statstable( _self, sym.code().raw() );
-    auto existing = statstable.find( sym.code().raw() );
-    eosio::check( existing != statstable.end(), "token with symbol does not exist" );
-    const auto& st = *existing;
-
-    require_auth( st.issuer );
-    eosio::check( quantity.is_valid(), "invalid quantity" );
-    eosio::check( quantity.amount > 0, "must retire positive quantity" );
-
-    eosio::check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-
-    statstable.modify( st, same_payer, [&]( auto& s ) {
-       s.supply -= quantity;
-    });
-
-    sub_balance( st.issuer, quantity );
+   basic_token::retire( quantity, memo );
 }
 
 void token::transfer( name    from,
@@ -89,143 +33,39 @@ void token::transfer( name    from,
                       asset   quantity,
                       string  memo )
 {
-    eosio::check( from != to, "cannot transfer to self" );
-    require_auth( from );
-    eosio::check( is_account( to ), "to account does not exist");
-    auto sym = quantity.symbol.code();
-    stats statstable( _self, sym.raw() );
-    const auto& st = statstable.get( sym.raw() );
-
-    require_recipient( from );
-    require_recipient( to );
-
-    eosio::check( quantity.is_valid(), "invalid quantity" );
-    eosio::check( quantity.amount > 0, "must transfer positive quantity" );
-    eosio::check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-    eosio::check( memo.size() <= 256, "memo has more than 256 bytes" );
-    eosio::check( st.paused == false, "token is paused" );
-
-    auto payer = has_auth( to ) ? to : from;
-
-    sub_balance( from, quantity );
-    add_balance( to, quantity, payer );
-}
-
-void token::sub_balance( name owner, asset value ) {
-   eosio::check( !is_frozen(owner), "account is frozen");
-
-   accounts from_acnts( _self, owner.value );
-
-   const auto& from = from_acnts.get( value.symbol.code().raw(), "no balance object found" );
-   eosio::check( from.balance.amount >= value.amount, "overdrawn balance" );
-
-   from_acnts.modify( from, owner, [&]( auto& a ) {
-      a.balance -= value;
-   });
-}
-
-void token::add_balance( name owner, asset value, name ram_payer )
-{
-   eosio::check( !is_frozen(owner), "account is frozen");
-
-   accounts to_acnts( _self, owner.value );
-   auto to = to_acnts.find( value.symbol.code().raw() );
-   if( to == to_acnts.end() ) {
-      to_acnts.emplace( ram_payer, [&]( auto& a ){
-        a.balance = value;
-      });
-   } else {
-      to_acnts.modify( to, same_payer, [&]( auto& a ) {
-        a.balance += value;
-      });
-   }
+   basic_token::transfer( from, to, quantity, memo );
 }
 
 void token::open( name owner, const symbol& symbol, name ram_payer )
 {
-   require_auth( ram_payer );
-
-   auto sym_code_raw = symbol.code().raw();
-
-   stats statstable( _self, sym_code_raw );
-   const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
-   eosio::check( st.supply.symbol == symbol, "symbol precision mismatch" );
-
-   accounts acnts( _self, owner.value );
-   auto it = acnts.find( sym_code_raw );
-   if( it == acnts.end() ) {
-      acnts.emplace( ram_payer, [&]( auto& a ){
-        a.balance = asset{0, symbol};
-      });
-   }
+   basic_token::open( owner, symbol, ram_payer );
 }
 
 void token::close( name owner, const symbol& symbol )
 {
-   eosio::check( !is_frozen(owner), "account is frozen");
-
-   require_auth( owner );
-   accounts acnts( _self, owner.value );
-   auto it = acnts.find( symbol.code().raw() );
-   eosio::check( it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect." );
-   eosio::check( it->balance.amount == 0, "Cannot close because the balance is not zero." );
-   acnts.erase( it );
+   basic_token::close( owner, symbol );
 }
 
 void token::freeze( name account )
 {
-   require_auth( _self );
-
-   auto fitr = _frozen_accounts.find( account.value );
-   eosio::check( fitr == _frozen_accounts.end(), "account already freezed");
-
-   _frozen_accounts.emplace( _self, [&]( auto& fa ) {
-      fa.account = account;
-   });
+   basic_token::freeze( account );
 }
 
 void token::unfreeze( name account )
 {
-   require_auth( _self );
-
-   auto fitr = _frozen_accounts.find( account.value );
-   eosio::check( fitr != _frozen_accounts.end(), "account not freezed");
-
-   _frozen_accounts.erase(fitr);
+   basic_token::unfreeze( account );
 }
 
 void token::pause( const symbol_code& sym )
 {
-   require_auth( _self );
-
-   stats statstable( _self, sym.raw() );
-   const auto& st = statstable.get( sym.raw() );
-
-   eosio::check( st.paused == false, "token already paused" );
-
-   statstable.modify( st, same_payer, [&]( auto& s ) {
-      s.paused = true;
-   });
+   basic_token::pause( sym );
 }
 
 void token::unpause( const symbol_code& sym )
 {
-   require_auth( _self );
-
-   stats statstable( _self, sym.raw() );
-   const auto& st = statstable.get( sym.raw() );
-
-   eosio::check( st.paused == true, "token not paused" );
-
-   statstable.modify( st, same_payer, [&]( auto& s ) {
-      s.paused = false;
-   });
-}
-
-bool token::is_frozen( name owner ) {
-   return _frozen_accounts.find(owner.value) != _frozen_accounts.end();
+   basic_token::unpause( sym );
 }
 
 } /// namespace eosio
 
-EOSIO_DISPATCH( eosio::token, (create)(issue)(transfer)(open)(close)(retire)(freeze)(unfreeze)(pause)(unpause) )
+EOSIO_DISPATCH( eosio::token, (create)(issue)(issuemany)(transfer)(open)(close)(retire)(freeze)(unfreeze)(pause)(unpause) )